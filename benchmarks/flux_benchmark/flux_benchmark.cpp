@@ -0,0 +1,85 @@
+#include "core/reactor.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <numeric>
+#include <vector>
+using namespace reactor;
+
+// Kept small because the adapter chain re-enters subscribe once per element.
+static constexpr int elementCount = 1024;
+
+static std::vector<int> makeInput()
+{
+    std::vector<int> input(elementCount);
+    std::iota(input.begin(), input.end(), 0);
+    return input;
+}
+
+template <int Stages>
+static auto& chainAdapters(auto& stage)
+{
+    if constexpr (Stages == 0)
+    {
+        return stage;
+    }
+    else
+    {
+        return chainAdapters<Stages - 1>(
+            stage.map([](const int& v) { return v + 1; }));
+    }
+}
+
+template <int Stages>
+static auto chainFused(auto stage)
+{
+    if constexpr (Stages == 0)
+    {
+        return stage;
+    }
+    else
+    {
+        return chainFused<Stages - 1>(
+            stage.map([](const int& v) { return v + 1; }));
+    }
+}
+
+template <int Stages>
+static void BM_AdapterPipeline(benchmark::State& state)
+{
+    auto input = makeInput();
+    for (auto _ : state)
+    {
+        auto flux = Flux<int>::range(input);
+        auto& first = flux.map([](const int& v) { return v + 1; });
+        auto& last = chainAdapters<Stages - 1>(first);
+        long sum = 0;
+        last.subscribe([&sum](const int& v) { sum += v; });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * elementCount);
+}
+
+template <int Stages>
+static void BM_FusedPipeline(benchmark::State& state)
+{
+    auto input = makeInput();
+    for (auto _ : state)
+    {
+        auto flux = Flux<int>::range(input);
+        auto last = chainFused<Stages>(flux.fuse());
+        long sum = 0;
+        last.subscribe([&sum](const int& v) { sum += v; });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * elementCount);
+}
+
+BENCHMARK_TEMPLATE(BM_AdapterPipeline, 1);
+BENCHMARK_TEMPLATE(BM_AdapterPipeline, 5);
+BENCHMARK_TEMPLATE(BM_AdapterPipeline, 10);
+BENCHMARK_TEMPLATE(BM_FusedPipeline, 1);
+BENCHMARK_TEMPLATE(BM_FusedPipeline, 5);
+BENCHMARK_TEMPLATE(BM_FusedPipeline, 10);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,83 @@
+#include "core/reactor.hpp"
+
+#include <benchmark/benchmark.h>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+using namespace reactor;
+
+static constexpr int distinctKeys = 100'000;
+static constexpr int elementCount = 1 << 20;
+
+// Events from many sensors, interleaved round robin, so every key comes
+// back only after all the others have been seen.
+static auto makeSource()
+{
+    return Flux<int>::generate([i = 0](bool& hasNext) mutable {
+        hasNext = i < elementCount - 1;
+        return i++;
+    });
+}
+
+static int sensorOf(const int& v)
+{
+    return v % distinctKeys;
+}
+
+// range(0) is the group cap. With room for every key each group lives for
+// the whole run; with fewer slots every new key evicts the least recently
+// used group and reopens it on its next turn.
+static void BM_GroupByInline(benchmark::State& state)
+{
+    GroupByOptions options{
+        .maxGroups = static_cast<std::size_t>(state.range(0))};
+    std::size_t groups = 0;
+    for (auto _ : state)
+    {
+        std::int64_t sum = 0;
+        groups = 0;
+        auto flux = makeSource();
+        flux.groupBy(sensorOf, options)
+            .subscribe([&sum, &groups](auto group) {
+            ++groups;
+            group->subscribe([&sum](int v) { sum += v; });
+        });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * elementCount);
+    state.counters["groups"] = static_cast<double>(groups);
+}
+BENCHMARK(BM_GroupByInline)->Arg(1 << 17)->Arg(1 << 12);
+
+// Groups pinned to strands over a pool. With this many keys a group rarely
+// has more than one value queued, so nearly every value costs a post.
+static void BM_GroupByPinned(benchmark::State& state)
+{
+    auto strands = static_cast<int>(state.range(0));
+    for (auto _ : state)
+    {
+        net::thread_pool pool(strands);
+        GroupByOptions options{.maxGroups = 1 << 17};
+        for (int i = 0; i < strands; ++i)
+        {
+            options.executors.push_back(net::make_strand(pool));
+        }
+        std::atomic<std::int64_t> sum{0};
+        auto flux = makeSource();
+        flux.groupBy(sensorOf, std::move(options))
+            .subscribe([&sum](auto group) {
+            group->subscribe([&sum](int v) {
+                sum.fetch_add(v, std::memory_order_relaxed);
+            });
+        });
+        pool.join();
+        benchmark::DoNotOptimize(sum.load());
+    }
+    state.SetItemsProcessed(state.iterations() * elementCount);
+}
+BENCHMARK(BM_GroupByPinned)->RangeMultiplier(2)->Range(1, 4)->UseRealTime();
+
+BENCHMARK_MAIN();
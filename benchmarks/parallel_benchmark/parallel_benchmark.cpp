@@ -0,0 +1,64 @@
+#include "core/reactor.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+using namespace reactor;
+
+static constexpr int elementCount = 1 << 14;
+
+// Stands in for per-sample telemetry post-processing.
+static std::uint64_t crunch(int v)
+{
+    std::uint64_t h = static_cast<std::uint64_t>(v);
+    for (int i = 0; i < 2000; ++i)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+    }
+    return h;
+}
+
+static auto makeSource()
+{
+    return Flux<int>::generate([i = 0](bool& hasNext) mutable {
+        hasNext = i < elementCount - 1;
+        return i++;
+    });
+}
+
+static void BM_SingleThread(benchmark::State& state)
+{
+    for (auto _ : state)
+    {
+        std::uint64_t sum = 0;
+        auto flux = makeSource();
+        flux.map([](const int& v) { return crunch(v); })
+            .subscribe([&sum](const std::uint64_t& v) { sum += v; });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * elementCount);
+}
+BENCHMARK(BM_SingleThread)->UseRealTime();
+
+static void BM_ParallelRails(benchmark::State& state)
+{
+    auto threads = static_cast<std::size_t>(state.range(0));
+    for (auto _ : state)
+    {
+        std::uint64_t sum = 0;
+        net::thread_pool pool(threads);
+        auto flux = makeSource();
+        flux.parallel(threads)
+            .runOn(pool)
+            .map([](const int& v) { return crunch(v); })
+            .sequential()
+            .subscribe([&sum](const std::uint64_t& v) { sum += v; });
+        pool.join();
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * elementCount);
+}
+BENCHMARK(BM_ParallelRails)->RangeMultiplier(2)->Range(1, 16)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,58 @@
+#include "core/sinks.hpp"
+
+#include <benchmark/benchmark.h>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <thread>
+#include <vector>
+using namespace reactor;
+
+static constexpr int perProducer = 1 << 16;
+
+// Producers push from their own threads while one io_context thread drains.
+// "contended" counts enqueue CAS collisions between producers.
+static void BM_ManyProducers(benchmark::State& state)
+{
+    auto producers = static_cast<int>(state.range(0));
+    std::size_t contended = 0;
+    for (auto _ : state)
+    {
+        net::io_context ioc;
+        auto work = net::make_work_guard(ioc);
+        auto sink = Sinks::many<int>(ioc.get_executor(), 4096,
+                                     OverflowStrategy::Spin);
+        auto flux = sink->asFlux();
+        long sum = 0;
+        flux.subscribe([&sum](int v) { sum += v; });
+        std::thread consumer([&ioc]() { ioc.run(); });
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p)
+        {
+            threads.emplace_back([&sink]() {
+                for (int i = 0; i < perProducer; ++i)
+                {
+                    sink->tryEmitNext(i);
+                }
+            });
+        }
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        sink->tryEmitComplete();
+        work.reset();
+        consumer.join();
+        benchmark::DoNotOptimize(sum);
+        contended += sink->stats().contended;
+    }
+    auto items = state.iterations() * producers * perProducer;
+    state.SetItemsProcessed(items);
+    state.counters["contended"] = benchmark::Counter(
+        static_cast<double>(contended), benchmark::Counter::kAvgIterations);
+    state.counters["contended/item"] =
+        static_cast<double>(contended) / static_cast<double>(items);
+}
+BENCHMARK(BM_ManyProducers)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
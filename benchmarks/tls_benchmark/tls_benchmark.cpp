@@ -0,0 +1,113 @@
+#include "client/http/async_streams.hpp"
+#include "server/http/http_server.hpp"
+
+#include <benchmark/benchmark.h>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <chrono>
+#include <thread>
+using namespace reactor;
+
+// Runs the library's own HttpsServer on a loopback port in the background.
+struct LocalHttpsServer
+{
+    net::io_context ioc;
+    HttpsServer server{ioc, "0", "/tmp/reactor_tls_benchmark"};
+    std::string port{
+        std::to_string(server.server.acceptor_.local_endpoint().port())};
+    std::thread runner;
+
+    LocalHttpsServer()
+    {
+        server.router().add_get_handler(
+            "/ping", [](const StringbodyRequest& req, const http_function&,
+                        net::yield_context) -> VariantResponse {
+            StringbodyResponse res{http::status::ok, req.version()};
+            res.body() = "pong";
+            res.prepare_payload();
+            return res;
+        });
+        server.listen();
+        runner = std::thread([this]() { ioc.run(); });
+    }
+    ~LocalHttpsServer()
+    {
+        ioc.stop();
+        runner.join();
+    }
+};
+
+// One connection: resolve, connect and handshake (timed), then a request so
+// that TLS 1.3 tickets are read, then shutdown.
+static std::chrono::duration<double> connectOnce(net::io_context& ioc,
+                                                 ssl::context& ctx,
+                                                 const std::string& port)
+{
+    tcp::resolver resolver(ioc);
+    auto stream = std::make_shared<AsyncSslStream>(ioc.get_executor(), ctx);
+    StringbodyRequest req{http::verb::get, "/ping", 11};
+    req.set(http::field::host, "127.0.0.1");
+    req.keep_alive(false);
+    beast::flat_buffer buffer;
+    StringbodyResponse res;
+    std::chrono::duration<double> handshake{};
+
+    stream->setErrorHandler([&stream](beast::error_code ec, const char* what) {
+        std::cerr << what << ": " << ec.message() << "\n";
+        stream->shutDown();
+    });
+    auto start = std::chrono::steady_clock::now();
+    stream->resolve(resolver, "127.0.0.1", port.data(),
+                    [&](beast::error_code) {
+        handshake = std::chrono::steady_clock::now() - start;
+        stream->write(req, [&](beast::error_code, std::size_t) {
+            stream->read(buffer, res, [&](beast::error_code, std::size_t) {
+                stream->shutDown();
+            });
+        });
+    });
+    ioc.run();
+    ioc.restart();
+    return handshake;
+}
+
+// Handshake latency against a local HttpsServer. Arg 0 forgets the cached
+// session before each connection, so every handshake is a full one; arg 1
+// lets the client resume the previous connection's session.
+static void BM_Handshake(benchmark::State& state)
+{
+    LocalHttpsServer server;
+    net::io_context ioc;
+    ssl::context ctx(ssl::context::tls_client);
+    ctx.set_verify_mode(ssl::verify_none);
+    auto& cache = TlsSessionCache::instance();
+    bool resume = state.range(0) != 0;
+    cache.clear();
+    connectOnce(ioc, ctx, server.port);
+    std::size_t handshakes = 0;
+    std::size_t resumed = 0;
+    for (auto _ : state)
+    {
+        if (!resume)
+        {
+            cache.clear();
+        }
+        auto before = cache.stats();
+        state.SetIterationTime(connectOnce(ioc, ctx, server.port).count());
+        auto after = cache.stats();
+        handshakes += after.handshakes - before.handshakes;
+        resumed += after.resumed - before.resumed;
+    }
+    state.counters["hitRate"] =
+        handshakes == 0 ? 0.0
+                        : static_cast<double>(resumed) /
+                              static_cast<double>(handshakes);
+}
+BENCHMARK(BM_Handshake)
+    ->Arg(0)
+    ->Arg(1)
+    ->UseManualTime()
+    ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
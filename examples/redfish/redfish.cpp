@@ -3,7 +3,9 @@
 using namespace reactor;
 struct Requester
 {
-    std::string token;
+    using LoginResponse = HttpExpected<http::response<http::string_body>>;
+    // One login per session lifetime, shared by every request in flight.
+    std::shared_ptr<MonoCache<LoginResponse>> session;
     std::string machine;
     ssl::context ctx{ssl::context::tlsv12_client};
     net::io_context& ioc;
@@ -14,7 +16,7 @@ struct Requester
     {
         usename = std::string(username.data(), username.size());
         password_ = std::string(pass.data(), pass.size());
-        token = std::string();
+        session.reset();
         return *this;
     }
     Requester& withMachine(std::string machine)
@@ -38,15 +40,16 @@ struct Requester
     }
     void getToken()
     {
-        getToken([]() {});
+        getToken([](const std::string&) {});
     }
     template <typename Contiuation>
     void getToken(Contiuation cont)
     {
-        if (token.empty())
+        if (!session)
         {
-            auto mono =
-                WebClient<SslStream, http::string_body>::builder()
+            session = Mono<LoginResponse>::cache(
+                [this]() {
+                return WebClient<SslStream, http::string_body>::builder()
                     .withSession(ioc.get_executor(), getContext())
                     .withEndpoint(std::format(
                         "https://{}.aus.stglabs.ibm.com:443/redfish/v1/SessionService/Sessions",
@@ -56,24 +59,28 @@ struct Requester
                     .withBody(nlohmann::json{{"UserName", user()},
                                              {"Password", password()}})
                     .toMono();
-            mono->asJson([this, mono, cont = std::move(cont)](auto& v) {
-                if (v.isError())
-                {
-                    REACTOR_LOG_ERROR("Error: {}", v.error().message());
-                    return;
-                }
-                REACTOR_LOG_ERROR("Error: {}", v.response().data().dump(4));
-                token = v.response().getHeaders()["X-Auth-Token"];
-                cont();
+            },
+                std::chrono::minutes(25), std::chrono::minutes(5));
+            session->cacheWhen([](const LoginResponse& v) {
+                return !v.isError() && v.response().count("X-Auth-Token");
             });
-            return;
         }
-        cont();
+        auto mono = std::make_shared<Mono<LoginResponse>>(session->asMono());
+        mono->subscribe(
+            [mono, cont = std::move(cont)](const LoginResponse& v) {
+            if (v.isError())
+            {
+                REACTOR_LOG_ERROR("Error: {}", v.error().message());
+                return;
+            }
+            cont(std::string(v.response()["X-Auth-Token"]));
+        });
     }
     template <typename Contiuation>
     void get(const std::string& target, Contiuation cont)
     {
-        getToken([this, cont = std::move(cont), target = target]() {
+        getToken([this, cont = std::move(cont),
+                  target = target](const std::string& token) {
             std::string ep = std::format(
                 "https://{}.aus.stglabs.ibm.com:443/{}", machine, target);
             auto mono = WebClient<AsyncSslStream, http::string_body>::builder()
@@ -1,6 +1,8 @@
 #pragma once
 #include "common/common_defs.hpp"
+#include "common/dns_cache.hpp"
 #include "logger/logger.hpp"
+#include "ssl/tls_session_cache.hpp"
 namespace reactor
 {
 template <typename Stream>
@@ -29,9 +31,14 @@ struct ASyncStream : public std::enable_shared_from_this<ASyncStream<Stream>>
         return mStream;
     }
     void on_resolve(std::function<void(beast::error_code)> connectionHandler,
-                    beast::error_code ec, tcp::resolver::results_type results)
+                    beast::error_code ec, std::vector<tcp::endpoint> results)
     {
         CLIENT_LOG_INFO("on_resolve {} : {}", ec.message(), ec.value());
+        if (!ec && shutDownCalled)
+        {
+            // Shut down while the lookup was in flight.
+            ec = net::error::operation_aborted;
+        }
         if (ec)
             return fail(ec, "resolve");
 
@@ -76,8 +83,8 @@ struct ASyncStream : public std::enable_shared_from_this<ASyncStream<Stream>>
     void resolve(tcp::resolver& resolver, const char* host, const char* port,
                  std::function<void(beast::error_code)> handler)
     {
-        resolver.async_resolve(
-            host, port,
+        DnsCache::instance().asyncResolve(
+            resolver.get_executor(), host, port,
             beast::bind_front_handler(&ASyncStream::on_resolve,
                                       Base::shared_from_this(),
                                       std::move(handler)));
@@ -154,6 +161,7 @@ struct AsyncSslStream : public ASyncStream<beast::ssl_stream<beast::tcp_stream>>
 {
   private:
     ssl::context& sslCtx;
+    std::string origin;
     void on_connect(std::function<void(beast::error_code)> connectionHandler,
                     beast::error_code ec,
                     tcp::resolver::results_type::endpoint_type) override
@@ -164,6 +172,7 @@ struct AsyncSslStream : public ASyncStream<beast::ssl_stream<beast::tcp_stream>>
 
         // Perform the SSL handshake
         CLIENT_LOG_INFO("try async_handshake");
+        TlsSessionCache::instance().prepare(stream().native_handle(), origin);
         stream().async_handshake(
             ssl::stream_base::client,
             [thisp = Base::shared_from_this(),
@@ -189,6 +198,8 @@ struct AsyncSslStream : public ASyncStream<beast::ssl_stream<beast::tcp_stream>>
                       beast::error_code ec)
     {
         CLIENT_LOG_INFO("handshake{} : {}", ec.message(), ec.value());
+        TlsSessionCache::instance().completed(stream().native_handle(), origin,
+                                              ec);
         if (ec)
             return fail(ec, "handshake");
         connectionHandler(ec);
@@ -213,6 +224,17 @@ struct AsyncSslStream : public ASyncStream<beast::ssl_stream<beast::tcp_stream>>
             static_cast<AsyncSslStream*>(thisp.get())->on_shutdown(ec);
         });
     }
+    // Remembers the origin so the handshake can resume its TLS session.
+    void resolve(tcp::resolver& resolver, const char* host, const char* port,
+                 std::function<void(beast::error_code)> handler)
+    {
+        origin = TlsSessionCache::originOf(host, port);
+        ASyncStream::resolve(resolver, host, port, std::move(handler));
+    }
+    ssl::context& sslContext() const
+    {
+        return sslCtx;
+    }
     AsyncSslStream makeCopy()
     {
         return AsyncSslStream(mStream.get_executor(), sslCtx);
@@ -1,6 +1,8 @@
 #pragma once
 #include "common/common_defs.hpp"
+#include "common/dns_cache.hpp"
 #include "logger/logger.hpp"
+#include "ssl/tls_session_cache.hpp"
 namespace reactor
 {
 template <typename Stream>
@@ -30,9 +32,14 @@ struct CoroStream : public std::enable_shared_from_this<CoroStream<Stream>>
         return mStream;
     }
     void on_resolve(std::function<void(beast::error_code)> connectionHandler,
-                    beast::error_code ec, tcp::resolver::results_type results)
+                    beast::error_code ec, std::vector<tcp::endpoint> results)
     {
         CLIENT_LOG_INFO("on_resolve {} : {}", ec.message(), ec.value());
+        if (!ec && shutDownCalled)
+        {
+            // Shut down while the lookup was in flight.
+            ec = net::error::operation_aborted;
+        }
         if (ec)
             return fail(ec, "resolve");
 
@@ -84,7 +91,8 @@ struct CoroStream : public std::enable_shared_from_this<CoroStream<Stream>>
                     handler = std::move(handler)](net::yield_context yield) {
             beast::error_code ec{};
             self->yield = yield;
-            auto results = resolver.async_resolve(shost, sport, yield[ec]);
+            auto results = DnsCache::instance().asyncResolve(
+                resolver.get_executor(), shost, sport, yield[ec]);
             on_resolve(std::move(handler), ec, results);
         });
     }
@@ -152,6 +160,7 @@ struct CoroSslStream : public CoroStream<beast::ssl_stream<beast::tcp_stream>>
 {
   private:
     ssl::context& sslCtx;
+    std::string origin;
     void on_connect(std::function<void(beast::error_code)> connectionHandler,
                     beast::error_code ec,
                     tcp::resolver::results_type::endpoint_type) override
@@ -162,6 +171,7 @@ struct CoroSslStream : public CoroStream<beast::ssl_stream<beast::tcp_stream>>
 
         // Perform the SSL handshake
         CLIENT_LOG_INFO("try async_handshake");
+        TlsSessionCache::instance().prepare(stream().native_handle(), origin);
         stream().async_handshake(ssl::stream_base::client, yield.value()[ec]);
         on_handshake(std::move(connectionHandler), ec);
     }
@@ -182,6 +192,8 @@ struct CoroSslStream : public CoroStream<beast::ssl_stream<beast::tcp_stream>>
                       beast::error_code ec)
     {
         CLIENT_LOG_INFO("handshake{} : {}", ec.message(), ec.value());
+        TlsSessionCache::instance().completed(stream().native_handle(), origin,
+                                              ec);
         if (ec)
             return fail(ec, "handshake");
         connectionHandler(ec);
@@ -205,6 +217,17 @@ struct CoroSslStream : public CoroStream<beast::ssl_stream<beast::tcp_stream>>
         stream().async_shutdown(yield.value()[ec]);
         on_shutdown(ec);
     }
+    // Remembers the origin so the handshake can resume its TLS session.
+    void resolve(tcp::resolver& resolver, const char* host, const char* port,
+                 std::function<void(beast::error_code)> handler)
+    {
+        origin = TlsSessionCache::originOf(host, port);
+        CoroStream::resolve(resolver, host, port, std::move(handler));
+    }
+    ssl::context& sslContext() const
+    {
+        return sslCtx;
+    }
     CoroSslStream makeCopy()
     {
         return CoroSslStream(mStream.get_executor(), sslCtx);
@@ -98,7 +98,7 @@ class HttpSession :
     Request req_;
     Response res_;
     using ResponseHandler =
-        std::function<void(const Request&, const HttpExpected&)>;
+        std::function<void(const Request&, HttpExpected)>;
 
     ResponseHandler responseHandler;
     std::string host;
@@ -124,6 +124,9 @@ class HttpSession :
     {}
     ~HttpSession()
     {
+        // The stream may outlive us with an operation in flight; its error
+        // handler must not reach back into this session.
+        stream->setErrorHandler([](beast::error_code, const char*) {});
         CLIENT_LOG_DEBUG("HttpSession destroyed");
     }
     auto get_executor()
@@ -137,7 +140,7 @@ class HttpSession :
             if (responseHandler)
             {
                 http::response<ResBody> res{http::status::not_found, 11};
-                responseHandler(req_, HttpExpected{res, ec});
+                responseHandler(req_, HttpExpected{std::move(res), ec});
             }
             if (stream && !stream->closed())
             {
@@ -232,6 +235,17 @@ class HttpSession :
     {
         stream->shutDown();
     }
+    // Abandons the exchange in flight. The pending resolve, connect, write
+    // or read completes with an error and nobody is told about it.
+    void cancel()
+    {
+        responseHandler = ResponseHandler{};
+        connectionState = std::monostate();
+        if (stream && !stream->closed())
+        {
+            stream->shutDown();
+        }
+    }
     void visit(auto&& handler)
     {
         std::visit(
@@ -254,6 +268,19 @@ class HttpSession :
         }
         visit([](auto& state) { state.write(); });
     }
+    // Opens the connection ahead of the first request, then calls done.
+    // A failure reaches the response handler like that of an exchange.
+    void connect(std::function<void()> done)
+    {
+        connectionState = InUse(Base::shared_from_this());
+        stream->resolve(resolver_, host.data(), port.data(),
+                        [self = Base::shared_from_this(),
+                         done = std::move(done)](beast::error_code) {
+            self->connectionState = Idle(self);
+            self->stream->monitorForError();
+            done();
+        });
+    }
     void run(Request&& req)
     {
         req_ = std::move(req);
@@ -311,6 +338,19 @@ class HttpSession :
         }
         stream->monitorForError();
     }
+    // The TLS context the stream was built with; null for plain TCP. Part
+    // of the key sessions are pooled under.
+    const void* tlsContext() const
+    {
+        if constexpr (requires { stream->sslContext(); })
+        {
+            return &stream->sslContext();
+        }
+        else
+        {
+            return nullptr;
+        }
+    }
     bool inUse() const
     {
         return std::holds_alternative<InUse>(connectionState);
@@ -1,14 +1,18 @@
 #pragma once
+#include "core/timer_wheel.hpp"
 #include "http_client.hpp"
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/beast.hpp>
+#include <boost/url/url_view.hpp>
 
-#include <algorithm> // Added for std::ranges::find
+#include <atomic>
 #include <deque>
+#include <functional>
 #include <memory>
-#include <ranges>
+#include <mutex>
+#include <unordered_map>
 
 namespace reactor
 {
@@ -19,65 +23,630 @@ concept SessionInitialiser =
             h(session)
         } -> std::same_as<void>;
     };
+
+// Requests may share a pooled connection only when they agree on scheme,
+// host, port and the TLS context the connection was set up with.
+struct PoolKey
+{
+    std::string scheme;
+    std::string host;
+    std::string port;
+    const void* tls{nullptr};
+
+    bool operator==(const PoolKey&) const = default;
+
+    static PoolKey of(std::string scheme, std::string host, std::string port,
+                      const void* tls = nullptr)
+    {
+        if (port.empty())
+        {
+            port = scheme == "https" ? "443" : "80";
+        }
+        return {std::move(scheme), std::move(host), std::move(port), tls};
+    }
+    static PoolKey of(boost::urls::url_view url, const void* tls = nullptr)
+    {
+        return of(url.scheme(), url.host(), url.port(), tls);
+    }
+};
+struct PoolKeyHash
+{
+    std::size_t operator()(const PoolKey& key) const
+    {
+        auto seed = std::hash<std::string>{}(key.host);
+        for (auto h : {std::hash<std::string>{}(key.port),
+                       std::hash<std::string>{}(key.scheme),
+                       std::hash<const void*>{}(key.tls)})
+        {
+            seed ^= h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    }
+};
+struct PoolLimits
+{
+    using Duration = TimerWheel::Duration;
+    std::size_t perOrigin{5};     // sessions open towards one origin
+    std::size_t maxWaiters{1024}; // queued acquires per origin
+    std::size_t maxRequests{0};   // exchanges per connection; 0: unbounded
+    Duration idleTimeout{std::chrono::seconds(30)}; // zero: never
+    Duration maxLifetime{};                          // zero: unbounded
+};
+struct PoolStats
+{
+    std::size_t open{0};
+    std::size_t idle{0};
+    std::size_t waiting{0};
+    std::size_t acquired{0}; // sessions handed out
+    std::size_t reused{0};   // ... that were already connected
+    std::size_t retired{0};  // closed for age, use count or idleness
+
+    double reuseRatio() const
+    {
+        return acquired ? static_cast<double>(reused) / acquired : 0.0;
+    }
+    PoolStats& operator+=(const PoolStats& other)
+    {
+        open += other.open;
+        idle += other.idle;
+        waiting += other.waiting;
+        acquired += other.acquired;
+        reused += other.reused;
+        retired += other.retired;
+        return *this;
+    }
+};
+
+// Connection manager shared by everything that talks to the same servers.
+// Sessions are grouped per origin; each origin keeps its idle sessions on an
+// intrusive list, so acquire and release never search. Once an origin has
+// opened its limit, acquire() queues the caller and the next session to be
+// released or discarded is handed to the oldest waiter. Waiters always
+// resume from the pool's executor, never from inside release(). Share the
+// pool through a shared_ptr, or use the one of() keeps per execution
+// context.
+//
+// Idle sessions are closed after PoolLimits::idleTimeout, and sessions past
+// their lifetime or request budget are closed instead of parked. warm()
+// connects sessions ahead of the first request and keeps that many open.
 template <typename Session>
-class HttpClientPool
+class HttpClientPool :
+    public std::enable_shared_from_this<HttpClientPool<Session>>
 {
   public:
+    using Factory = std::function<std::shared_ptr<Session>()>;
+    using Handler =
+        std::function<void(beast::error_code, std::shared_ptr<Session>)>;
+    using Clock = TimerWheel::Clock;
+
+  private:
+    struct Origin;
+    struct Slot
+    {
+        std::shared_ptr<Session> session;
+        Origin* origin{nullptr};
+        Slot* prev{nullptr};
+        Slot* next{nullptr};
+        bool idle{false};
+        bool connected{false};
+        std::size_t uses{0};
+        Clock::time_point born{Clock::now()};
+        TimerWheel::Handle expiry;
+    };
+    struct Waiter
+    {
+        Factory make;
+        Handler handler;
+        std::atomic<bool> cancelled{false};
+    };
+    struct Origin
+    {
+        const PoolKey* key{nullptr};
+        Slot* idle{nullptr};
+        std::size_t idleCount{0};
+        std::size_t open{0};
+        std::size_t limit{0}; // 0: PoolLimits::perOrigin
+        std::size_t warm{0};
+        Factory make; // set by warm()
+        std::deque<std::shared_ptr<Waiter>> waiters;
+        std::size_t acquired{0};
+        std::size_t reused{0};
+        std::size_t retired{0};
+    };
+    using SlotMap = std::unordered_map<const Session*, std::unique_ptr<Slot>>;
+
+    // Keeps the pool of() hands out for one execution context.
+    struct Service : net::execution_context::service
+    {
+        using key_type = Service;
+        static inline net::execution_context::id id;
+        std::mutex mutex;
+        std::shared_ptr<HttpClientPool> pool;
+        explicit Service(net::execution_context& ctx) :
+            net::execution_context::service(ctx)
+        {}
+        void shutdown() override
+        {
+            std::lock_guard lock(mutex);
+            pool.reset();
+        }
+    };
+
+  public:
+    // Cancelling is safe from any thread; a waiter that was already handed
+    // a session keeps it.
+    class Handle
+    {
+        std::shared_ptr<Waiter> waiter;
+
+      public:
+        Handle() = default;
+        explicit Handle(std::shared_ptr<Waiter> w) : waiter(std::move(w)) {}
+        void cancel()
+        {
+            if (waiter)
+            {
+                waiter->cancelled = true;
+                waiter.reset();
+            }
+        }
+        bool pending() const
+        {
+            return waiter && !waiter->cancelled;
+        }
+    };
+
     explicit HttpClientPool(net::any_io_executor executor,
-                            std::size_t pool_size) :
-        context(executor),
-        poolSize(pool_size)
+                            PoolLimits poolLimits = {}) :
+        context(std::move(executor)), limits(poolLimits)
+    {}
+    HttpClientPool(net::any_io_executor executor, std::size_t pool_size) :
+        HttpClientPool(std::move(executor), PoolLimits{.perOrigin = pool_size})
     {}
     ~HttpClientPool()
     {
-        while (pool.size() > 0)
+        // Busy sessions belong to whoever holds them; only idle ones are
+        // ours to close.
+        for (auto& [session, slot] : slots)
         {
-            auto session = pool.front();
-            pool.pop_front();
-            session->close();
+            slot->expiry.cancel();
+            if (slot->idle)
+            {
+                slot->session->close();
+            }
         }
-
         CLIENT_LOG_DEBUG("HttpClientPool destroyed");
     }
+    // The pool shared by every client on executor's execution context; it
+    // is created on first use and goes away with the context.
+    static std::shared_ptr<HttpClientPool> of(const net::any_io_executor& ex)
+    {
+        auto& service = net::use_service<Service>(
+            net::query(ex, net::execution::context));
+        std::lock_guard lock(service.mutex);
+        if (!service.pool)
+        {
+            service.pool = std::make_shared<HttpClientPool>(ex);
+        }
+        return service.pool;
+    }
     HttpClientPool& withPoolSize(std::size_t pool_size)
     {
-        poolSize = pool_size;
+        std::lock_guard lock(mutex);
+        limits.perOrigin = pool_size;
+        return *this;
+    }
+    HttpClientPool& withLimits(PoolLimits poolLimits)
+    {
+        std::lock_guard lock(mutex);
+        limits = poolLimits;
         return *this;
     }
-    template <typename... Args>
-    std::shared_ptr<Session> acquire(auto intializer, Args&&... args)
+    // Overrides PoolLimits::perOrigin for one origin.
+    HttpClientPool& withOriginLimit(const PoolKey& key, std::size_t limit)
     {
-        // Check if there is an available session in the pool
-        auto it = std::ranges::find_if(
-            pool, [](const auto& s) { return !s->inUse(); });
-        if (it != std::end(pool))
+        std::lock_guard lock(mutex);
+        originOf(key).limit = limit;
+        return *this;
+    }
+    // Connects up to count sessions to key ahead of the first request, and
+    // replaces them as they are retired or fail.
+    void warm(const PoolKey& key, Factory make, std::size_t count)
+    {
+        std::vector<std::shared_ptr<Session>> fresh;
         {
-            return *it;
+            std::lock_guard lock(mutex);
+            auto& origin = originOf(key);
+            origin.warm = count;
+            origin.make = std::move(make);
+            while (origin.open < std::min(count, limitOf(origin)))
+            {
+                fresh.push_back(open(origin, origin.make));
+            }
         }
-        if (pool.size() < poolSize)
+        for (auto& session : fresh)
         {
-            pool.push_back(
-                Session::create(context, std::forward<Args>(args)...));
-            intializer(pool.back());
-            return pool.back();
+            connect(key, session);
         }
-        return std::shared_ptr<Session>();
     }
 
-    void release(std::shared_ptr<Session> session)
+    // An idle session, a new one if the origin is below its limit, or null.
+    std::shared_ptr<Session> tryAcquire(const PoolKey& key, const Factory& make)
+    {
+        std::lock_guard lock(mutex);
+        return take(originOf(key), make);
+    }
+    // Runs handler inline when a session is at hand, otherwise queues it
+    // behind earlier waiters. Fails with no_buffer_space once the origin's
+    // queue is full.
+    Handle acquire(const PoolKey& key, Factory make, Handler handler)
+    {
+        std::shared_ptr<Session> session;
+        {
+            std::lock_guard lock(mutex);
+            auto& origin = originOf(key);
+            if (origin.waiters.empty())
+            {
+                session = take(origin, make);
+            }
+            if (!session)
+            {
+                if (origin.waiters.size() < limits.maxWaiters)
+                {
+                    auto waiter = std::make_shared<Waiter>(std::move(make),
+                                                           std::move(handler));
+                    origin.waiters.push_back(waiter);
+                    return Handle(std::move(waiter));
+                }
+            }
+        }
+        if (!session)
+        {
+            handler(net::error::no_buffer_space, nullptr);
+            return Handle();
+        }
+        handler(beast::error_code{}, std::move(session));
+        return Handle();
+    }
+    // Returns a healthy session to its origin, or straight to the oldest
+    // waiter. A session past its lifetime or request budget is closed.
+    void release(const std::shared_ptr<Session>& session)
+    {
+        std::unique_lock lock(mutex);
+        auto it = slots.find(session.get());
+        if (it == slots.end() || it->second->idle)
+        {
+            return;
+        }
+        auto* slot = it->second.get();
+        slot->connected = true;
+        if (spent(*slot))
+        {
+            drop(std::move(lock), it, true);
+            return;
+        }
+        if (auto waiter = nextWaiter(*slot->origin))
+        {
+            lend(*slot);
+            lock.unlock();
+            handOver(std::move(waiter), session);
+            return;
+        }
+        pushIdle(*slot->origin, slot);
+        lock.unlock();
+        watch(session);
+    }
+    // Forgets a broken or closed session; the room it frees goes to the
+    // oldest waiter.
+    void discard(const std::shared_ptr<Session>& session)
     {
-        auto it = std::ranges::find_if(
-            pool, [&](const auto& s) { return s.get() == session.get(); });
-        if (it != pool.end())
+        std::unique_lock lock(mutex);
+        auto it = slots.find(session.get());
+        if (it == slots.end())
         {
-            pool.erase(it);
+            return;
         }
+        drop(std::move(lock), it, false);
+    }
+    PoolStats stats(const PoolKey& key) const
+    {
+        std::lock_guard lock(mutex);
+        auto it = origins.find(key);
+        if (it == origins.end())
+        {
+            return {};
+        }
+        return statsOf(it->second);
+    }
+    PoolStats stats() const
+    {
+        std::lock_guard lock(mutex);
+        PoolStats total;
+        for (const auto& [key, origin] : origins)
+        {
+            total += statsOf(origin);
+        }
+        return total;
     }
 
   private:
     net::any_io_executor context;
-    std::size_t poolSize;
-    std::deque<std::shared_ptr<Session>> pool;
+    PoolLimits limits;
+    mutable std::mutex mutex;
+    std::unordered_map<PoolKey, Origin, PoolKeyHash> origins;
+    SlotMap slots;
+
+    Origin& originOf(const PoolKey& key)
+    {
+        auto [it, added] = origins.try_emplace(key);
+        it->second.key = &it->first;
+        return it->second;
+    }
+    static PoolStats statsOf(const Origin& origin)
+    {
+        return {origin.open,     origin.idleCount, origin.waiters.size(),
+                origin.acquired, origin.reused,    origin.retired};
+    }
+    std::size_t limitOf(const Origin& origin) const
+    {
+        return origin.limit ? origin.limit : limits.perOrigin;
+    }
+    bool spent(const Slot& slot) const
+    {
+        return (limits.maxRequests && slot.uses >= limits.maxRequests) ||
+               (limits.maxLifetime > PoolLimits::Duration::zero() &&
+                Clock::now() - slot.born >= limits.maxLifetime);
+    }
+    std::shared_ptr<Session> take(Origin& origin, const Factory& make)
+    {
+        while (auto* slot = origin.idle)
+        {
+            unlinkIdle(origin, slot);
+            if (spent(*slot))
+            {
+                retire(origin, slots.find(slot->session.get()));
+                continue;
+            }
+            lend(*slot);
+            return slot->session;
+        }
+        if (origin.open < limitOf(origin))
+        {
+            auto session = open(origin, make);
+            lend(*slots[session.get()]);
+            return session;
+        }
+        return nullptr;
+    }
+    std::shared_ptr<Session> open(Origin& origin, const Factory& make)
+    {
+        auto slot = std::make_unique<Slot>();
+        slot->session = make();
+        slot->origin = &origin;
+        auto session = slot->session;
+        slots.emplace(session.get(), std::move(slot));
+        ++origin.open;
+        return session;
+    }
+    void lend(Slot& slot)
+    {
+        ++slot.uses;
+        ++slot.origin->acquired;
+        if (slot.connected)
+        {
+            ++slot.origin->reused;
+        }
+    }
+    // Closes the session once the current callback has unwound.
+    void retire(Origin& origin, SlotMap::iterator it)
+    {
+        auto session = std::move(it->second->session);
+        forget(origin, it);
+        ++origin.retired;
+        net::post(context, [session = std::move(session)]() {
+            session->close();
+        });
+    }
+    void forget(Origin& origin, SlotMap::iterator it)
+    {
+        it->second->expiry.cancel();
+        if (it->second->idle)
+        {
+            unlinkIdle(origin, it->second.get());
+        }
+        slots.erase(it);
+        --origin.open;
+    }
+    // Takes a session out of the pool, then spends the room on the oldest
+    // waiter or on keeping the origin warm.
+    void drop(std::unique_lock<std::mutex> lock, SlotMap::iterator it,
+              bool close)
+    {
+        auto& origin = *it->second->origin;
+        if (close)
+        {
+            retire(origin, it);
+        }
+        else
+        {
+            forget(origin, it);
+        }
+        if (auto waiter = nextWaiter(origin))
+        {
+            auto replacement = open(origin, waiter->make);
+            lend(*slots[replacement.get()]);
+            lock.unlock();
+            handOver(std::move(waiter), std::move(replacement));
+            return;
+        }
+        if (origin.open < std::min(origin.warm, limitOf(origin)) &&
+            origin.make)
+        {
+            auto replacement = open(origin, origin.make);
+            auto key = *origin.key;
+            lock.unlock();
+            connect(key, std::move(replacement));
+        }
+    }
+    void connect(const PoolKey& key, std::shared_ptr<Session> session)
+    {
+        session->setOptions(Host{key.host}, Port{key.port});
+        session->setResponseHandler(idleWatcher(session));
+        session->connect([self = this->weak_from_this(),
+                          session = std::weak_ptr<Session>(session)]() {
+            auto pool = self.lock();
+            auto warmed = session.lock();
+            if (pool && warmed)
+            {
+                pool->release(warmed);
+            }
+        });
+    }
+    std::shared_ptr<Waiter> nextWaiter(Origin& origin)
+    {
+        while (!origin.waiters.empty())
+        {
+            auto waiter = std::move(origin.waiters.front());
+            origin.waiters.pop_front();
+            if (!waiter->cancelled)
+            {
+                return waiter;
+            }
+        }
+        return nullptr;
+    }
+    void handOver(std::shared_ptr<Waiter> waiter,
+                  std::shared_ptr<Session> session)
+    {
+        net::post(context, [self = this->weak_from_this(),
+                            waiter = std::move(waiter),
+                            session = std::move(session)]() {
+            if (!waiter->cancelled.exchange(true))
+            {
+                waiter->handler(beast::error_code{}, session);
+                return;
+            }
+            // Cancelled after it was picked: pass the session on.
+            if (auto pool = self.lock())
+            {
+                pool->release(session);
+            }
+        });
+    }
+    // Forgets the session once its connection fails. Deferred, as the
+    // session is still inside its error handler.
+    auto idleWatcher(const std::shared_ptr<Session>& session)
+    {
+        return [self = this->weak_from_this(),
+                session = std::weak_ptr<Session>(session)](
+                   const typename Session::Request&,
+                   const typename Session::HttpExpected& res) {
+            if (!res.isError())
+            {
+                return;
+            }
+            auto pool = self.lock();
+            if (!pool)
+            {
+                return;
+            }
+            net::post(pool->context, [self, session]() {
+                auto pool = self.lock();
+                auto broken = session.lock();
+                if (pool && broken)
+                {
+                    pool->discard(broken);
+                }
+            });
+        };
+    }
+    // A parked session must not call back into its last user, who may be
+    // gone by the time the peer closes the connection. release() usually
+    // runs inside that very callback, so the handler is swapped later.
+    void watch(const std::shared_ptr<Session>& session)
+    {
+        net::post(context, [self = this->weak_from_this(),
+                            session = std::weak_ptr<Session>(session)]() {
+            auto pool = self.lock();
+            auto parked = session.lock();
+            if (!pool || !parked)
+            {
+                return;
+            }
+            std::lock_guard lock(pool->mutex);
+            auto it = pool->slots.find(parked.get());
+            if (it != pool->slots.end() && it->second->idle)
+            {
+                parked->setResponseHandler(pool->idleWatcher(parked));
+            }
+        });
+    }
+    void expire(const std::shared_ptr<Session>& session)
+    {
+        std::unique_lock lock(mutex);
+        auto it = slots.find(session.get());
+        if (it == slots.end() || !it->second->idle)
+        {
+            return;
+        }
+        auto& origin = *it->second->origin;
+        if (origin.open <= origin.warm)
+        {
+            arm(*it->second);
+            return;
+        }
+        retire(origin, it);
+    }
+    void arm(Slot& slot)
+    {
+        if (limits.idleTimeout <= PoolLimits::Duration::zero())
+        {
+            return;
+        }
+        slot.expiry = TimerWheel::of(context).schedule(
+            limits.idleTimeout, context,
+            [self = this->weak_from_this(),
+             session = std::weak_ptr<Session>(slot.session)]() {
+            auto pool = self.lock();
+            auto parked = session.lock();
+            if (pool && parked)
+            {
+                pool->expire(parked);
+            }
+        });
+    }
+    void pushIdle(Origin& origin, Slot* slot)
+    {
+        slot->idle = true;
+        slot->prev = nullptr;
+        slot->next = origin.idle;
+        if (origin.idle)
+        {
+            origin.idle->prev = slot;
+        }
+        origin.idle = slot;
+        ++origin.idleCount;
+        arm(*slot);
+    }
+    void unlinkIdle(Origin& origin, Slot* slot)
+    {
+        slot->expiry.cancel();
+        if (slot->prev)
+        {
+            slot->prev->next = slot->next;
+        }
+        else
+        {
+            origin.idle = slot->next;
+        }
+        if (slot->next)
+        {
+            slot->next->prev = slot->prev;
+        }
+        slot->prev = slot->next = nullptr;
+        slot->idle = false;
+        --origin.idleCount;
+    }
 };
 
 } // namespace reactor
@@ -23,6 +23,10 @@ struct HttpExpected
     {
         return resp;
     }
+    auto& response()
+    {
+        return resp;
+    }
     std::string to_string() const
     {
         return resp.body();
@@ -2,12 +2,12 @@
 #include "http_client_pool.hpp"
 #include "retry_request.hpp"
 
-#include <boost/circular_buffer.hpp>
 #include <boost/url/url.hpp>
 #include <boost/url/url_view.hpp>
 
 #include <map>
 #include <string>
+#include <vector>
 namespace reactor
 {
 class HttpSubscriber
@@ -17,16 +17,31 @@ class HttpSubscriber
     using Request = Session::Request;
     using Response = Session::Response;
     using RetryRequest = RetryRequest<Request>;
+    using Pool = HttpClientPool<Session>;
 
   private:
   public:
     HttpSubscriber(net::any_io_executor ioc, std::string destUrl) :
-        ioContext(ioc), destUrl(destUrl), httpClientPool(ioContext, 5)
+        ioContext(ioc), destUrl(destUrl),
+        httpClientPool(std::make_shared<Pool>(ioContext, 5))
     {
         ctx.set_verify_mode(ssl::verify_none);
     }
+    // Queued acquires and pending retries call back into this object, so
+    // they go with it.
     ~HttpSubscriber()
     {
+        for (auto& handle : waiting)
+        {
+            handle.cancel();
+        }
+        for (auto& retry : retries)
+        {
+            if (auto retryRequest = retry.lock())
+            {
+                retryRequest->cancel();
+            }
+        }
         CLIENT_LOG_INFO("HttpSubscriber destroyed");
     }
     HttpSubscriber(HttpSubscriber&&) = default;
@@ -38,6 +53,7 @@ class HttpSubscriber
     HttpSubscriber& withSslContext(ssl::context&& sslctx)
     {
         ctx = std::move(sslctx);
+        prototype.reset();
         return *this;
     }
     HttpSubscriber& withSuccessHandler(
@@ -48,7 +64,13 @@ class HttpSubscriber
     }
     HttpSubscriber& withPoolSize(std::size_t poolSize)
     {
-        httpClientPool.withPoolSize(poolSize);
+        httpClientPool->withPoolSize(poolSize);
+        return *this;
+    }
+    // Shares connections with other clients of the same pool.
+    HttpSubscriber& withPool(std::shared_ptr<Pool> pool)
+    {
+        httpClientPool = std::move(pool);
         return *this;
     }
     HttpSubscriber& withHeaders(Headers aheaders)
@@ -57,11 +79,19 @@ class HttpSubscriber
         return *this;
     }
 
+    // Waits in the pool's queue while every connection to the destination
+    // is busy.
     void sendEvent(const std::string& data)
     {
-        // Acquire a session from the HttpClientPool
-        auto session = httpClientPool.acquire(
-            [&](std::shared_ptr<Session>& session) {
+        track(httpClientPool->acquire(
+            origin(), connector(),
+            [this, data](beast::error_code ec,
+                         std::shared_ptr<Session> session) {
+            if (ec)
+            {
+                CLIENT_LOG_ERROR("Event dropped: {}", ec.message());
+                return;
+            }
             boost::urls::url_view urlvw(destUrl);
             std::string h = urlvw.host();
             std::string p = urlvw.port();
@@ -74,16 +104,9 @@ class HttpSubscriber
             session->setResponseHandler(
                 std::bind_front(&HttpSubscriber::handleResponse, this,
                                 std::weak_ptr<Session>(session)));
-        },
-            ctx);
-        // Send the data using the acquired session
-        if (session)
-        {
             session->setOption(data);
             session->run();
-            return;
-        }
-        eventBuffer.push_back(data);
+        }));
     }
 
   private:
@@ -100,20 +123,39 @@ class HttpSubscriber
         }
         if (!res.keep_alive())
         {
-            httpClientPool.release(session);
+            httpClientPool->discard(session);
+            return;
         }
-        sendNext();
+        httpClientPool->release(session);
     }
-    void sendNext()
+    // Pooled sessions are cloned from this one, which also supplies the
+    // TLS part of the pool key.
+    Session& sessionPrototype()
     {
-        if (eventBuffer.empty())
+        if (!prototype)
         {
-            return;
+            prototype = Session::create(ioContext, ctx);
+        }
+        return *prototype;
+    }
+    PoolKey origin()
+    {
+        return PoolKey::of(boost::urls::url_view(destUrl),
+                           sessionPrototype().tlsContext());
+    }
+    Pool::Factory connector()
+    {
+        sessionPrototype();
+        return [proto = prototype]() { return proto->clone(); };
+    }
+    void track(Pool::Handle handle)
+    {
+        std::erase_if(waiting,
+                      [](const auto& queued) { return !queued.pending(); });
+        if (handle.pending())
+        {
+            waiting.push_back(std::move(handle));
         }
-
-        auto next = std::move(eventBuffer.front());
-        eventBuffer.pop_front();
-        sendEvent(next);
     }
     void handleRetryResponse(std::weak_ptr<Session> session,
                              std::shared_ptr<RetryRequest> retryRequest,
@@ -125,7 +167,7 @@ class HttpSubscriber
         {
             CLIENT_LOG_ERROR("Error: {}", response.error().message());
             retryRequest->setRequest(ptr->takeRequest());
-            httpClientPool.release(ptr);
+            httpClientPool->discard(ptr);
             retryRequest->waitAndRetry();
 
             return;
@@ -139,7 +181,7 @@ class HttpSubscriber
         if (response.isError())
         {
             CLIENT_LOG_ERROR("Error: {}", response.error().message());
-            httpClientPool.release(ptr);
+            httpClientPool->discard(ptr);
             retryIfNeeded(ptr->takeRequest());
             return;
         }
@@ -150,12 +192,14 @@ class HttpSubscriber
   private:
     net::any_io_executor ioContext;
     std::string destUrl;
-    HttpClientPool<Session> httpClientPool;
+    std::shared_ptr<Pool> httpClientPool;
     ssl::context ctx{ssl::context::tlsv12_client};
     Headers headers;
     RetryPolicy retryPolicy;
-    boost::circular_buffer<std::string> eventBuffer{100};
     std::function<void(const Request&, const Response&)> successHandler;
+    std::shared_ptr<Session> prototype;
+    std::vector<Pool::Handle> waiting;
+    std::vector<std::weak_ptr<RetryRequest>> retries;
 
     void retryIfNeeded(Request&& req)
     {
@@ -169,8 +213,18 @@ class HttpSubscriber
             [retrySelf = std::weak_ptr<RetryRequest>(retryRequest), this]() {
             if (auto retryRequest = retrySelf.lock())
             {
-                auto session = httpClientPool.acquire(
-                    [&retryRequest, this](std::shared_ptr<Session>& session) {
+                track(httpClientPool->acquire(
+                    origin(), connector(),
+                    [retryRequest, this](beast::error_code ec,
+                                         std::shared_ptr<Session> session) {
+                    if (ec)
+                    {
+                        // No room to queue. So retry again by reducing the
+                        // retry count
+                        retryRequest->policy.decrementRetryCount();
+                        retryRequest->waitAndRetry();
+                        return;
+                    }
                     session->setOption(retryRequest->req.base());
                     session->setOption(
                         Host{retryRequest->req.base()[http::field::host]});
@@ -179,19 +233,13 @@ class HttpSubscriber
                     session->setResponseHandler(std::bind_front(
                         &HttpSubscriber::handleRetryResponse, this,
                         std::weak_ptr(session), retryRequest));
-                },
-                    ctx);
-                if (session)
-                { // got free session from pool
                     session->run(std::move(retryRequest->req));
-                    return;
-                }
-                // failed to get a session . So retry again by reducing the
-                // retry count
-                retryRequest->policy.decrementRetryCount();
-                retryRequest->waitAndRetry();
+                }));
             }
         };
+        std::erase_if(retries,
+                      [](const auto& retry) { return retry.expired(); });
+        retries.push_back(retryRequest);
         retryRequest->waitAndRetry();
     }
 };
@@ -1,5 +1,5 @@
 #pragma once
-#include <boost/asio/steady_timer.hpp>
+#include "core/timer_wheel.hpp"
 
 #include <functional>
 #include <memory>
@@ -33,10 +33,11 @@ struct RetryRequest : std::enable_shared_from_this<RetryRequest<Request>>
     using Base = std::enable_shared_from_this<RetryRequest<Request>>;
     Request req;
     RetryPolicy policy;
-    boost::asio::steady_timer timer;
+    net::any_io_executor executor;
+    TimerWheel::Handle timer;
     std::function<void()> retryFunction;
     RetryRequest(Request&& r, const RetryPolicy& p, net::any_io_executor ex) :
-        req(std::move(r)), policy(p), timer(ex)
+        req(std::move(r)), policy(p), executor(std::move(ex))
     {}
     ~RetryRequest()
     {
@@ -51,15 +52,15 @@ struct RetryRequest : std::enable_shared_from_this<RetryRequest<Request>>
         if (policy.retryNeeded())
         {
             policy.incrementRetryCount();
-            timer.expires_after(policy.getRetryDelay());
-            timer.async_wait([self = Base::shared_from_this()](
-                                 const boost::system::error_code& ec) {
-                if (!ec)
-                {
-                    self->retryFunction();
-                }
-            });
+            timer = TimerWheel::of(executor).schedule(
+                policy.getRetryDelay(), executor,
+                [self = Base::shared_from_this()]() { self->retryFunction(); });
         }
     }
+    void cancel()
+    {
+        timer.cancel();
+        retryFunction = nullptr;
+    }
 };
 } // namespace reactor
@@ -1,5 +1,6 @@
 #pragma once
 #include "common/common_defs.hpp"
+#include "common/dns_cache.hpp"
 namespace reactor
 {
 template <typename Stream>
@@ -27,7 +28,7 @@ struct SyncStream : public std::enable_shared_from_this<SyncStream<Stream>>
     }
     virtual void
         on_resolve(std::function<void(beast::error_code)> connectionHandler,
-                   tcp::resolver::results_type results) = 0;
+                   std::vector<tcp::endpoint> results) = 0;
 
   public:
     void setErrorHandler(ErrorHandler handler)
@@ -38,7 +39,8 @@ struct SyncStream : public std::enable_shared_from_this<SyncStream<Stream>>
                  std::function<void(beast::error_code)> handler)
     {
         beast::error_code ec{};
-        tcp::resolver::results_type result = resolver.resolve(host, port, ec);
+        auto result = DnsCache::instance().resolve(resolver.get_executor(),
+                                                   host, port, ec);
         if (ec)
         {
             return fail(ec, "resolve");
@@ -90,7 +92,7 @@ struct TcpStream : public SyncStream<beast::tcp_stream>
 {
   protected:
     void on_resolve(std::function<void(beast::error_code)> connectionHandler,
-                    tcp::resolver::results_type results) override
+                    std::vector<tcp::endpoint> results) override
     {
         // Set a timeout on the operation
         lowestLayer().expires_after(std::chrono::seconds(30));
@@ -123,7 +125,7 @@ struct SslStream : public SyncStream<beast::ssl_stream<beast::tcp_stream>>
   private:
     ssl::context& sslCtx;
     void on_resolve(std::function<void(beast::error_code)> connectionHandler,
-                    tcp::resolver::results_type results) override
+                    std::vector<tcp::endpoint> results) override
     {
         // Set a timeout on the operation
         lowestLayer().expires_after(std::chrono::seconds(30));
@@ -170,6 +172,10 @@ struct SslStream : public SyncStream<beast::ssl_stream<beast::tcp_stream>>
         // If we get here then the connection is closed
         // gracefully
     }
+    ssl::context& sslContext() const
+    {
+        return sslCtx;
+    }
     SslStream makeCopy()
     {
         return SslStream(mStream.get_executor(), sslCtx);
@@ -1,5 +1,6 @@
 #pragma once
 #include "client/http/http_client.hpp"
+#include "client/http/http_client_pool.hpp"
 #include "client/http/retry_request.hpp"
 #include "core/reactor.hpp"
 
@@ -29,13 +30,30 @@ struct ResponseEntity
 template <typename Res, typename Session>
 struct HttpSource : FluxBase<Res>::SourceHandler
 {
+    using Pool = HttpClientPool<Session>;
     std::shared_ptr<Session> session;
     int count{1};
     bool forever{false};
+    // With a pool, session only holds the request; each exchange runs on a
+    // lease taken from the pool.
+    std::shared_ptr<Pool> pool;
+    PoolKey origin;
+    std::shared_ptr<Session> lease;
+    typename Pool::Handle waiting;
     explicit HttpSource(std::shared_ptr<Session> aSession, int shots,
                         bool infinite = false) :
         session(std::move(aSession)), count(shots), forever(infinite)
     {}
+    ~HttpSource()
+    {
+        waiting.cancel();
+        dropLease();
+    }
+    void usePool(std::shared_ptr<Pool> aPool, PoolKey key)
+    {
+        pool = std::move(aPool);
+        origin = std::move(key);
+    }
     auto getSession() const
     {
         return session;
@@ -66,9 +84,16 @@ struct HttpSource : FluxBase<Res>::SourceHandler
     void next(std::function<void(Res)> consumer) override
     {
         decrement();
+        if (pool)
+        {
+            nextOnLease(std::move(consumer));
+            return;
+        }
         session->setResponseHandler(
-            [consumer = std::move(consumer)](
-                const Session::Request&, const Res& res) { consumer(res); });
+            [consumer = std::move(consumer)](const Session::Request&,
+                                             Res res) {
+            consumer(std::move(res));
+        });
         session->setOptions(KeepAlive{forever});
         session->run();
     }
@@ -80,6 +105,59 @@ struct HttpSource : FluxBase<Res>::SourceHandler
     {
         forever = false;
     }
+    void cancel() override
+    {
+        stop();
+        count = 0;
+        session->cancel();
+        waiting.cancel();
+        dropLease();
+    }
+
+  private:
+    void nextOnLease(std::function<void(Res)> consumer)
+    {
+        waiting = pool->acquire(
+            origin, [proto = session]() { return proto->clone(); },
+            [this, consumer = std::move(consumer)](
+                beast::error_code ec, std::shared_ptr<Session> leased) mutable {
+            if (ec)
+            {
+                consumer(Res{{http::status::service_unavailable, 11}, ec});
+                return;
+            }
+            lease = std::move(leased);
+            lease->setResponseHandler(
+                [this, consumer = std::move(consumer)](const Session::Request&,
+                                                       Res res) {
+                giveBack(res);
+                consumer(std::move(res));
+            });
+            lease->setOption(session->copyRequest());
+            lease->setOptions(Host{origin.host}, Port{origin.port},
+                              KeepAlive{true});
+            lease->run();
+        });
+    }
+    void giveBack(const Res& res)
+    {
+        auto done = std::move(lease);
+        if (res.isError() || !res.response().keep_alive())
+        {
+            pool->discard(done);
+            return;
+        }
+        pool->release(done);
+    }
+    void dropLease()
+    {
+        if (lease)
+        {
+            lease->cancel();
+            pool->discard(lease);
+            lease.reset();
+        }
+    }
 };
 
 template <typename Session>
@@ -96,6 +174,7 @@ struct HttpFluxBase :
     using Base = FluxBase<HttpExpected<http::response<Body>>>;
     using RetryRequest = RetryRequest<typename Session::Request>;
     RetryPolicy retryPolicy;
+    std::weak_ptr<RetryRequest> pendingRetry;
     explicit HttpFluxBase(Base::SourceHandler* srcHandler) : Base(srcHandler) {}
 
     static HttpFluxBase connect(std::shared_ptr<Session> session,
@@ -115,6 +194,20 @@ struct HttpFluxBase :
         auto m = std::make_shared<HttpFluxBase>(src);
         return m;
     }
+    // Runs every exchange on a connection borrowed from pool.
+    void withPool(std::shared_ptr<HttpClientPool<Session>> pool, PoolKey key)
+    {
+        static_cast<HttpSource*>(Base::source())
+            ->usePool(std::move(pool), std::move(key));
+    }
+    void cancel() override
+    {
+        Base::cancel();
+        if (auto retryRequest = pendingRetry.lock())
+        {
+            retryRequest->cancel();
+        }
+    }
     void retry(int count)
     {
         retryPolicy = {.maxRetries = count, .retryCount = 0, .retryDelay = 15};
@@ -142,13 +235,14 @@ struct HttpFluxBase :
             };
 
             retryRequest->waitAndRetry();
+            pendingRetry = retryRequest;
             return true;
         }
         return false;
     }
-    void subscribeWithRetry(auto handler)
+    Disposable subscribeWithRetry(auto handler)
     {
-        Base::subscribe(
+        return Base::subscribe(
             [handler = std::move(handler),
              self = Base::shared_from_this()](auto v, auto reqNext) mutable {
             try
@@ -181,9 +275,9 @@ struct HttpFluxBase :
     // }
     // using Base::subscribe;
     template <typename Handler>
-    void asJson(Handler h)
+    Disposable asJson(Handler h)
     {
-        subscribeWithRetry([h = std::move(h)](auto& v) mutable {
+        return subscribeWithRetry([h = std::move(h)](auto& v) mutable {
             using Entity = ResponseEntity<nlohmann::json, http::response<Body>>;
             nlohmann::json resJson = nlohmann::json::parse(v.response().body(),
                                                            nullptr, false);
@@ -213,32 +307,103 @@ struct HttpSink
     using Response = Session::HttpExpected;
 
     using ResponseHandler = std::function<void(const Response&, bool&)>;
+    using Pool = HttpClientPool<Session>;
     std::shared_ptr<Session> session;
     std::string url;
+    std::string separator{"\n"};
     ResponseHandler onDataHandler;
+    std::shared_ptr<Pool> pool;
+    typename Pool::Handle waiting;
     explicit HttpSink(std::shared_ptr<Session> aSession) :
         session(std::move(aSession))
     {}
     ~HttpSink()
     {
-        // std::cout << "Destructor Called for HttpSink";
+        waiting.cancel();
     }
     HttpSink& setUrl(std::string u)
     {
         url = std::move(u);
         return *this;
     }
+    // Posts over connections borrowed from the pool; the session given at
+    // construction only serves as the template they are cloned from.
+    HttpSink& withPool(std::shared_ptr<Pool> aPool)
+    {
+        pool = std::move(aPool);
+        return *this;
+    }
     HttpSink& onData(ResponseHandler dataHandler)
     {
         onDataHandler = std::move(dataHandler);
         return *this;
     }
+    // Placed between the elements of a batch in the request body.
+    HttpSink& setSeparator(std::string sep)
+    {
+        separator = std::move(sep);
+        return *this;
+    }
 
     void operator()(const SourceType& res, auto&& requestNext)
     {
-        session->setResponseHandler(
-            [this, requestNext = std::move(requestNext)](
+        post(tostring(res), std::move(requestNext));
+    }
+    // Batch mode, for buffer()/window() upstream: the whole span goes out
+    // as one request.
+    void operator()(std::span<const SourceType> batch, auto&& requestNext)
+    {
+        typename Session::RequestBody::value_type body;
+        for (const auto& res : batch)
+        {
+            if (&res != batch.data())
+            {
+                body += separator;
+            }
+            body += tostring(res);
+        }
+        post(std::move(body), std::move(requestNext));
+    }
+    void post(typename Session::RequestBody::value_type body,
+              auto&& requestNext)
+    {
+        if (!pool)
+        {
+            post(session, std::move(body), std::move(requestNext));
+            return;
+        }
+        boost::urls::url_view urlvw(url);
+        waiting = pool->acquire(
+            PoolKey::of(urlvw, session->tlsContext()),
+            [proto = session]() { return proto->clone(); },
+            [this, body = std::move(body),
+             requestNext = std::move(requestNext)](
+                beast::error_code ec, std::shared_ptr<Session> lease) mutable {
+            if (ec)
+            {
+                Response res{http::response<typename Session::ResponseBody>{
+                                 http::status::service_unavailable, 11},
+                             ec};
+                bool neednext{false};
+                if (onDataHandler)
+                {
+                    onDataHandler(res, neednext);
+                }
+                requestNext(neednext);
+                return;
+            }
+            post(std::move(lease), std::move(body), std::move(requestNext));
+        });
+    }
+    void post(std::shared_ptr<Session> target,
+              typename Session::RequestBody::value_type body,
+              auto&& requestNext)
+    {
+        target->setResponseHandler(
+            [this, lease = std::weak_ptr<Session>(target),
+             requestNext = std::move(requestNext)](
                 const Session::Request&, const Response& res) {
+            giveBack(lease.lock(), res);
             bool neednext{false};
             if (onDataHandler)
             {
@@ -250,13 +415,24 @@ struct HttpSink
         std::string h = urlvw.host();
         std::string p = urlvw.port();
         std::string path = urlvw.path();
-        using namespace std;
-        typename Session::RequestBody::value_type body = tostring(res);
 
-        session->setOptions(Host{h}, Port{p}, Target{path}, Version{11},
-                            Verb{http::verb::post}, KeepAlive{true}, body,
-                            ContentType{"plain/text"});
-        session->run();
+        target->setOptions(Host{h}, Port{p}, Target{path}, Version{11},
+                           Verb{http::verb::post}, KeepAlive{true},
+                           std::move(body), ContentType{"plain/text"});
+        target->run();
+    }
+    void giveBack(const std::shared_ptr<Session>& lease, const Response& res)
+    {
+        if (!pool || !lease)
+        {
+            return;
+        }
+        if (res.isError() || !res.response().keep_alive())
+        {
+            pool->discard(lease);
+            return;
+        }
+        pool->release(lease);
     }
     auto tostring(const auto& res)
     {
@@ -285,22 +461,15 @@ inline auto createHttpSink(std::shared_ptr<Session> aSession)
     return HttpSink<SourceType, Session>(std::move(aSession));
 }
 
-template <typename Body = http::string_body>
+template <typename Body, typename... Sinks>
 using HttpBroadCastingSink =
-    AsyncSinkGroup<HttpExpected<http::response<Body>>,
-                   HttpSink<HttpExpected<http::response<Body>>,
-                            HttpSession<AsyncSslStream, Body>>,
-                   HttpSink<HttpExpected<http::response<Body>>,
-                            HttpSession<AsyncTcpStream, Body>>>;
+    AsyncSinkGroup<HttpExpected<http::response<Body>>, Sinks...>;
 
 template <typename Body, typename... Args>
 inline auto createHttpBroadCaster(Args&&... args)
 {
-    using BroadCaster = HttpBroadCastingSink<Body>;
-    using BroadCasterSinks = typename BroadCaster::Sinks;
-    BroadCasterSinks vecSinks{std::forward<Args>(args)...};
-
-    return BroadCaster(std::move(vecSinks));
+    using BroadCaster = HttpBroadCastingSink<Body, std::decay_t<Args>...>;
+    return BroadCaster(std::forward<Args>(args)...);
 }
 template <typename... Args>
 inline auto createStringBodyBroadCaster(Args&&... args)
@@ -308,6 +477,14 @@ inline auto createStringBodyBroadCaster(Args&&... args)
     return createHttpBroadCaster<http::string_body>(
         std::forward<Args>(args)...);
 }
+// Each sink runs at its own pace; wrap sinks with makeLane() to set their
+// queue and overflow policy.
+template <typename Body, typename... Sinks>
+inline auto createDecoupledHttpBroadCaster(SinkLane<Sinks>... lanes)
+{
+    return createDecoupledSinkGroup<HttpExpected<http::response<Body>>>(
+        std::move(lanes)...);
+}
 template <typename Stream, typename ReqBody = http::empty_body,
           typename ResBody = http::string_body>
 struct WebClient
@@ -323,6 +500,8 @@ struct WebClient
     int retryCount{0};
     std::shared_ptr<Session> session;
     reactor::Verb verb;
+    std::string scheme;
+    std::shared_ptr<HttpClientPool<Session>> pool;
 
   public:
     struct WebClientBuilder
@@ -330,7 +509,10 @@ struct WebClient
         std::string host;
         std::string port;
         std::string target;
+        std::string scheme;
         std::shared_ptr<Session> session;
+        std::shared_ptr<HttpClientPool<Session>> pool;
+        bool sharedPool{false};
         template <typename... Args>
         WebClientBuilder& withSession(auto ex, Args&&... args)
         {
@@ -345,8 +527,24 @@ struct WebClient
         {
             return withEndpoint(std::string(url));
         }
+        // Clients built with the same pool share their connections to an
+        // origin.
+        WebClientBuilder&
+            withPool(std::shared_ptr<HttpClientPool<Session>> aPool)
+        {
+            pool = std::move(aPool);
+            return *this;
+        }
+        // Uses the pool shared across the execution context, so connections
+        // outlive the client that opened them.
+        WebClientBuilder& withPool()
+        {
+            sharedPool = true;
+            return *this;
+        }
         WebClientBuilder& withEndpoint(boost::urls::url_view urlvw)
         {
+            scheme = urlvw.scheme();
             host = urlvw.host();
             port = urlvw.port();
             target = urlvw.path();
@@ -375,6 +573,13 @@ struct WebClient
             client.port = reactor::Port{port};
             client.target = reactor::Target{target};
             client.session = session->clone();
+            client.scheme = scheme;
+            client.pool = pool;
+            if (!client.pool && sharedPool)
+            {
+                client.pool =
+                    HttpClientPool<Session>::of(session->get_executor());
+            }
             return client;
         }
     };
@@ -480,8 +685,10 @@ struct WebClient
         session->setOption(host);
         session->setOption(target);
         session->setOption(verb);
+        auto key = poolKey();
         auto m2 = HttpFlux<Session>::makeShared(std::move(session));
         m2->retry(retryCount);
+        usePool(*m2, std::move(key));
         return m2;
     }
 
@@ -491,8 +698,23 @@ struct WebClient
         session->setOption(host);
         session->setOption(target);
         session->setOption(verb);
+        auto key = poolKey();
         auto m2 = HttpMono<Session>::makeShared(std::move(session));
+        usePool(*m2, std::move(key));
         return m2;
     }
+
+  private:
+    PoolKey poolKey() const
+    {
+        return PoolKey::of(scheme, host, port, session->tlsContext());
+    }
+    void usePool(auto& flux, PoolKey key)
+    {
+        if (pool)
+        {
+            flux.withPool(pool, std::move(key));
+        }
+    }
 };
 } // namespace reactor
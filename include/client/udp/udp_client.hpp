@@ -1,5 +1,6 @@
 #pragma once
 #include "common/common_defs.hpp"
+#include "common/dns_cache.hpp"
 #include "logger/logger.hpp"
 namespace reactor
 {
@@ -42,8 +43,18 @@ struct UdpClient
     bool resolve(std::string_view host, std::string_view port)
     {
         error_code ec{};
-        endpoints = *resolver.async_resolve(host, port, yield.value()[ec]);
-        return !checkFailed(ec, "resolve");
+        auto results = DnsCache::instance().asyncResolve<udp>(
+            resolver.get_executor(), host, port, yield.value()[ec]);
+        if (!ec && results.empty())
+        {
+            ec = net::error::host_not_found;
+        }
+        if (checkFailed(ec, "resolve"))
+        {
+            return false;
+        }
+        endpoints = results.front();
+        return true;
     }
     bool resolve(std::string_view port)
     {
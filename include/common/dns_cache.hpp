@@ -0,0 +1,352 @@
+#pragma once
+#include "beast_defs.hpp"
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+namespace reactor
+{
+struct DnsOptions
+{
+    using Duration = std::chrono::steady_clock::duration;
+    Duration positiveTtl{std::chrono::seconds(30)};
+    Duration negativeTtl{std::chrono::seconds(5)};
+    std::size_t capacity{1024}; // cached names
+};
+struct DnsStats
+{
+    std::size_t hits{0};
+    std::size_t misses{0};    // lookups that went to the resolver
+    std::size_t coalesced{0}; // joined a lookup already in flight
+    std::size_t failures{0};
+};
+
+// Process-wide cache of name lookups, keyed by host:port. A miss runs one
+// resolver lookup however many callers ask for the name meanwhile; they
+// all complete with its result. Failures are cached too, for the shorter
+// negative TTL. Each hit hands out the addresses rotated by one, so
+// connections to a multi-homed name spread over its addresses.
+class DnsCache
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Addresses = std::vector<net::ip::address>;
+
+  private:
+    using Waiter = std::function<void(const beast::error_code&,
+                                      const Addresses&, unsigned short)>;
+    struct Entry
+    {
+        Addresses addresses;
+        unsigned short port{0};
+        beast::error_code error;
+        Clock::time_point expires;
+        std::size_t next{0};
+        bool resolving{false};
+        std::vector<Waiter> waiters;
+    };
+    struct Answer
+    {
+        Waiter waiter;
+        Addresses addresses;
+    };
+    // Rides along with the resolver's handler. Should the handler be
+    // destroyed without running, say with its io_context, the lookup is
+    // settled as aborted; the entry would otherwise stay resolving and
+    // every later caller of the name would queue behind it.
+    struct Flight
+    {
+        DnsCache* cache;
+        std::string key;
+        bool landed{false};
+        ~Flight()
+        {
+            if (!landed)
+            {
+                cache->settle(key, net::error::operation_aborted, {}, 0);
+            }
+        }
+    };
+
+  public:
+    static DnsCache& instance()
+    {
+        static DnsCache cache;
+        return cache;
+    }
+    DnsCache& withOptions(DnsOptions dnsOptions)
+    {
+        std::lock_guard lock(mutex);
+        options = dnsOptions;
+        return *this;
+    }
+    // Completes with the endpoints for host:port. Works with any asio
+    // completion token; the handler never runs inside this call.
+    template <typename Protocol = tcp, typename Token>
+    auto asyncResolve(net::any_io_executor ex, std::string_view host,
+                      std::string_view port, Token&& token)
+    {
+        using Endpoints = std::vector<typename Protocol::endpoint>;
+        return net::async_initiate<Token, void(beast::error_code, Endpoints)>(
+            [this, ex](auto handler, std::string host, std::string port) {
+            using Handler = decltype(handler);
+            auto executor = net::get_associated_executor(handler, ex);
+            struct Pending
+            {
+                Handler handler;
+                net::executor_work_guard<decltype(executor)> work;
+            };
+            auto pending = std::make_shared<Pending>(
+                Pending{std::move(handler), net::make_work_guard(executor)});
+            lookup<Protocol>(
+                ex, std::move(host), std::move(port),
+                [pending](const beast::error_code& ec,
+                          const Addresses& addresses, unsigned short number) {
+                auto endpoints = toEndpoints<Protocol>(addresses, number);
+                auto done = pending->work.get_executor();
+                net::post(done, [pending, ec,
+                                 endpoints = std::move(endpoints)]() mutable {
+                    pending->work.reset();
+                    std::move(pending->handler)(ec, std::move(endpoints));
+                });
+            });
+        },
+            token, std::string(host), std::string(port));
+    }
+    // Blocking flavour for the synchronous streams. A miss resolves on the
+    // calling thread and does not wait for lookups already in flight.
+    template <typename Protocol = tcp>
+    std::vector<typename Protocol::endpoint>
+        resolve(net::any_io_executor ex, std::string_view host,
+                std::string_view port, beast::error_code& ec)
+    {
+        auto key = keyOf(host, port);
+        {
+            std::lock_guard lock(mutex);
+            auto it = entries.find(key);
+            if (it != entries.end() && fresh(it->second))
+            {
+                ++counters.hits;
+                ec = it->second.error;
+                return toEndpoints<Protocol>(rotate(it->second),
+                                             it->second.port);
+            }
+            ++counters.misses;
+        }
+        typename Protocol::resolver resolver(ex);
+        auto results = resolver.resolve(host, port, ec);
+        auto [addresses, number] = addressesOf(results);
+        std::vector<Answer> answers;
+        Addresses mine;
+        {
+            std::lock_guard lock(mutex);
+            auto& entry = store(key, ec, std::move(addresses), number,
+                                answers);
+            mine = rotate(entry);
+        }
+        answer(answers, ec, number);
+        return toEndpoints<Protocol>(mine, number);
+    }
+    // Pins host:port to fixed addresses, e.g. from configuration.
+    void insert(std::string_view host, std::string_view port,
+                Addresses addresses, unsigned short number,
+                DnsOptions::Duration ttl)
+    {
+        std::vector<Answer> answers;
+        {
+            std::lock_guard lock(mutex);
+            store(keyOf(host, port), {}, std::move(addresses), number,
+                  answers, ttl);
+        }
+        answer(answers, {}, number);
+    }
+    void clear()
+    {
+        std::lock_guard lock(mutex);
+        std::erase_if(entries,
+                      [](const auto& item) { return !item.second.resolving; });
+        counters = {};
+    }
+    DnsStats stats() const
+    {
+        std::lock_guard lock(mutex);
+        return counters;
+    }
+
+  private:
+    mutable std::mutex mutex;
+    DnsOptions options;
+    DnsStats counters;
+    std::unordered_map<std::string, Entry> entries;
+
+    static std::string keyOf(std::string_view host, std::string_view port)
+    {
+        std::string key(host);
+        key += ':';
+        key += port;
+        return key;
+    }
+    template <typename Protocol>
+    static std::vector<typename Protocol::endpoint>
+        toEndpoints(const Addresses& addresses, unsigned short port)
+    {
+        std::vector<typename Protocol::endpoint> endpoints;
+        endpoints.reserve(addresses.size());
+        for (const auto& address : addresses)
+        {
+            endpoints.emplace_back(address, port);
+        }
+        return endpoints;
+    }
+    template <typename Results>
+    static std::pair<Addresses, unsigned short>
+        addressesOf(const Results& results)
+    {
+        Addresses addresses;
+        unsigned short port{0};
+        for (const auto& result : results)
+        {
+            auto endpoint = result.endpoint();
+            port = endpoint.port();
+            if (std::ranges::find(addresses, endpoint.address()) ==
+                addresses.end())
+            {
+                addresses.push_back(endpoint.address());
+            }
+        }
+        return {std::move(addresses), port};
+    }
+    bool fresh(const Entry& entry) const
+    {
+        return !entry.resolving && Clock::now() < entry.expires;
+    }
+    Addresses rotate(Entry& entry)
+    {
+        auto addresses = entry.addresses;
+        if (!addresses.empty())
+        {
+            std::ranges::rotate(addresses, addresses.begin() +
+                                               (entry.next++ %
+                                                addresses.size()));
+        }
+        return addresses;
+    }
+    template <typename Protocol>
+    void lookup(net::any_io_executor ex, std::string host, std::string port,
+                Waiter waiter)
+    {
+        auto key = keyOf(host, port);
+        std::unique_lock lock(mutex);
+        auto it = entries.find(key);
+        if (it != entries.end() && fresh(it->second))
+        {
+            ++counters.hits;
+            auto addresses = rotate(it->second);
+            auto ec = it->second.error;
+            auto number = it->second.port;
+            lock.unlock();
+            waiter(ec, addresses, number);
+            return;
+        }
+        if (it != entries.end() && it->second.resolving)
+        {
+            ++counters.coalesced;
+            it->second.waiters.push_back(std::move(waiter));
+            return;
+        }
+        ++counters.misses;
+        auto& entry = it != entries.end() ? it->second : add(key);
+        entry.resolving = true;
+        entry.waiters.push_back(std::move(waiter));
+        lock.unlock();
+
+        auto resolver = std::make_shared<typename Protocol::resolver>(ex);
+        auto flight = std::make_shared<Flight>(this, std::move(key));
+        resolver->async_resolve(
+            host, port,
+            [this, resolver, flight](const beast::error_code& ec,
+                                     const auto& results) {
+            flight->landed = true;
+            auto [addresses, number] = addressesOf(results);
+            settle(flight->key, ec, std::move(addresses), number);
+        });
+    }
+    void settle(const std::string& key, const beast::error_code& ec,
+                Addresses addresses, unsigned short number)
+    {
+        std::vector<Answer> answers;
+        {
+            std::lock_guard lock(mutex);
+            store(key, ec, std::move(addresses), number, answers);
+        }
+        answer(answers, ec, number);
+    }
+    Entry& add(const std::string& key)
+    {
+        if (entries.size() >= options.capacity)
+        {
+            auto now = Clock::now();
+            std::erase_if(entries, [now](const auto& item) {
+                return !item.second.resolving && item.second.expires <= now;
+            });
+        }
+        if (entries.size() >= options.capacity)
+        {
+            auto victim = std::ranges::find_if(entries, [](const auto& item) {
+                return !item.second.resolving;
+            });
+            if (victim != entries.end())
+            {
+                entries.erase(victim);
+            }
+        }
+        return entries[key];
+    }
+    // Records a lookup and collects the callers that waited on it.
+    Entry& store(const std::string& key, const beast::error_code& ec,
+                 Addresses addresses, unsigned short number,
+                 std::vector<Answer>& answers,
+                 std::optional<DnsOptions::Duration> ttl = std::nullopt)
+    {
+        auto it = entries.find(key);
+        auto& entry = it != entries.end() ? it->second : add(key);
+        entry.addresses = std::move(addresses);
+        entry.port = number;
+        entry.error = ec;
+        entry.resolving = false;
+        if (ec)
+        {
+            ++counters.failures;
+        }
+        // A cancelled lookup says nothing about the name.
+        auto lifetime = ec == net::error::operation_aborted
+                            ? DnsOptions::Duration::zero()
+                        : ec ? options.negativeTtl
+                             : ttl.value_or(options.positiveTtl);
+        entry.expires = Clock::now() + lifetime;
+        for (auto& waiter : entry.waiters)
+        {
+            answers.push_back({std::move(waiter), rotate(entry)});
+        }
+        entry.waiters.clear();
+        return entry;
+    }
+    static void answer(std::vector<Answer>& answers,
+                       const beast::error_code& ec, unsigned short number)
+    {
+        for (auto& [waiter, addresses] : answers)
+        {
+            waiter(ec, addresses, number);
+        }
+    }
+};
+} // namespace reactor
@@ -3,6 +3,7 @@
 #include "common_defs.hpp"
 
 #include <concepts>
+#include <cstddef>
 #include <functional>
 namespace reactor
 {
@@ -20,16 +21,67 @@ concept FilterFunction = requires(Handler h, Arg&& arg) {
                              } -> std::same_as<bool>;
                          };
 
-using CompletionToken = std::function<void(bool)>;
+// Demand side of a subscription. request(n) lets the source emit n more
+// values without waiting for another round trip; cancel() stops it for good.
+struct Subscription
+{
+    virtual void request(std::size_t n) = 0;
+    virtual void cancel() = 0;
+
+  protected:
+    ~Subscription() = default;
+};
+
+// Handed to async subscribers with every value. Calling it with true is the
+// original one-at-a-time protocol and maps to request(1).
+class CompletionToken
+{
+    Subscription* subscription{nullptr};
+
+  public:
+    CompletionToken() = default;
+    explicit CompletionToken(Subscription* sub) : subscription(sub) {}
+    void operator()(bool next) const
+    {
+        if (next)
+        {
+            request(1);
+        }
+    }
+    void request(std::size_t n) const
+    {
+        if (subscription != nullptr)
+        {
+            subscription->request(n);
+        }
+    }
+    void cancel() const
+    {
+        if (subscription != nullptr)
+        {
+            subscription->cancel();
+        }
+    }
+};
+// Subscribers take values as rvalues where they can; handlers written
+// against lvalues (auto& v) are accepted too.
 template <typename Handler, typename Arg>
-concept SyncSubScribeFunction = requires(Handler h, const Arg& arg) {
+concept SyncSubScribeFunction = requires(Handler h, Arg&& arg) {
                                     {
-                                        h(arg)
+                                        h(std::move(arg))
                                     } -> std::same_as<void>;
-                                };
+                                } || requires(Handler h, Arg& arg) {
+                                         {
+                                             h(arg)
+                                         } -> std::same_as<void>;
+                                     };
 template <typename Handler, typename Arg>
 concept AsyncSubScribeFunction =
-    requires(Handler h, const Arg& arg, CompletionToken&& token) {
+    requires(Handler h, Arg&& arg, CompletionToken&& token) {
+        {
+            h(std::move(arg), std::move(token))
+        } -> std::same_as<void>;
+    } || requires(Handler h, Arg& arg, CompletionToken&& token) {
         {
             h(arg, std::move(token))
         } -> std::same_as<void>;
@@ -1,86 +1,797 @@
 #pragma once
 #include "common/reactor_concepts.hpp"
+#include "core/timer_wheel.hpp"
 
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/circular_buffer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <deque>
+#include <expected>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <variant>
+#include <vector>
 namespace reactor
 {
+namespace net = boost::asio;
 
 struct SubscriberBase : std::enable_shared_from_this<SubscriberBase>
 {
     virtual ~SubscriberBase() {}
+    // Drops the subscriber this stage delivers to, and with it whatever the
+    // handler captured. Used by dispose().
+    virtual void release() {}
+    // Only roots do something here; see FluxBase::dispose().
+    virtual void dispose() {}
+};
+
+// Returned by subscribe(). dispose() stops the subscription from outside the
+// pipeline: the source is cancelled, which drops in-flight I/O and pending
+// timers, and every stage lets go of its handler. Disposing twice, or after
+// a shared root is gone, does nothing. A handle taken from a root that is not
+// owned by a shared_ptr must not outlive it. Dispose on the executor the
+// source runs on, as its sockets and timers are not thread-safe.
+class Disposable
+{
+    SubscriberBase* root{nullptr};
+    std::weak_ptr<SubscriberBase> owner;
+    bool shared{false};
+
+  public:
+    Disposable() = default;
+    explicit Disposable(SubscriberBase* r) :
+        root(r), owner(r->weak_from_this()), shared(!owner.expired())
+    {}
+    void dispose()
+    {
+        auto* target = std::exchange(root, nullptr);
+        if (!target)
+        {
+            return;
+        }
+        if (!shared)
+        {
+            target->dispose();
+            return;
+        }
+        if (auto keepAlive = owner.lock())
+        {
+            target->dispose();
+        }
+    }
+    bool disposed() const
+    {
+        return root == nullptr || (shared && owner.expired());
+    }
+};
+
+struct ArenaStats
+{
+    std::size_t adapters{0};
+    std::size_t upstreamAllocations{0};
+    std::size_t upstreamBytes{0};
+};
+
+// Owns every operator stage hanging off one FluxBase root. Stages are carved
+// out of a monotonic buffer that starts in an inline block, so a typical
+// pipeline costs a single heap allocation (the arena itself) no matter how
+// many stages it has. Everything is released in one shot with the root.
+class PipelineArena
+{
+    struct CountingResource : std::pmr::memory_resource
+    {
+        std::size_t allocations{0};
+        std::size_t bytes{0};
+        void* do_allocate(std::size_t size, std::size_t align) override
+        {
+            ++allocations;
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, align);
+        }
+        void do_deallocate(void* p, std::size_t size,
+                           std::size_t align) override
+        {
+            std::pmr::new_delete_resource()->deallocate(p, size, align);
+        }
+        bool do_is_equal(
+            const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+    struct OwnedStage
+    {
+        SubscriberBase* stage;
+        OwnedStage* next;
+    };
+    static constexpr std::size_t inlineSize = 1024;
+
+    alignas(std::max_align_t) std::array<std::byte, inlineSize> inlineBuffer;
+    CountingResource upstream;
+    std::pmr::monotonic_buffer_resource resource{
+        inlineBuffer.data(), inlineBuffer.size(), &upstream};
+    OwnedStage* stages{nullptr};
+    std::size_t stageCount{0};
+
+  public:
+    PipelineArena() = default;
+    PipelineArena(const PipelineArena&) = delete;
+    PipelineArena& operator=(const PipelineArena&) = delete;
+    ~PipelineArena()
+    {
+        // Stages are chained child after parent, so the list is already in
+        // reverse creation order.
+        for (auto* owned = stages; owned != nullptr; owned = owned->next)
+        {
+            owned->stage->~SubscriberBase();
+        }
+    }
+    template <typename Stage, typename... Args>
+    Stage& make(Args&&... args)
+    {
+        std::pmr::polymorphic_allocator<> alloc(&resource);
+        auto* stage = alloc.new_object<Stage>(std::forward<Args>(args)...);
+        stages = alloc.new_object<OwnedStage>(OwnedStage{stage, stages});
+        ++stageCount;
+        return *stage;
+    }
+    void release()
+    {
+        for (auto* owned = stages; owned != nullptr; owned = owned->next)
+        {
+            owned->stage->release();
+        }
+    }
+    ArenaStats stats() const
+    {
+        return {stageCount, upstream.allocations, upstream.bytes};
+    }
+};
+
+// Base of the stages a PipelineArena owns. Operators hand out references
+// to them; a stage copied out of its arena would be subscribed detached
+// from the pipeline, so copying one does not compile.
+struct ArenaStage
+{
+    ArenaStage() = default;
+    ArenaStage(const ArenaStage&) = delete;
+    ArenaStage& operator=(const ArenaStage&) = delete;
+};
+
+// Raises an outstanding demand by n. Demand saturates: at the maximum it
+// stands for unbounded and further requests leave it there.
+inline void addDemand(std::atomic<std::size_t>& demand, std::size_t n)
+{
+    constexpr auto unbounded = std::numeric_limits<std::size_t>::max();
+    auto current = demand.load();
+    while (!demand.compare_exchange_weak(
+        current, (unbounded - current < n) ? unbounded : current + n))
+    {}
+}
+
+// Work-in-progress count of a stage that may be driven from several threads.
+// The thread that raises it from zero owns the drain and makes passes until
+// nobody signalled more work meanwhile; everyone else only signals. So one
+// thread at a time delivers, and a request made from inside a delivery
+// leaves the stack flat.
+class WorkInProgress
+{
+    std::atomic<std::size_t> count{0};
+
+  public:
+    // Signals work; true if the caller now owns the drain.
+    bool enter()
+    {
+        return count.fetch_add(1) == 0;
+    }
+    // Makes the owner's passes.
+    template <typename Pass>
+    void run(Pass&& pass)
+    {
+        std::size_t missed = 1;
+        do
+        {
+            pass();
+            missed = count.fetch_sub(missed) - missed;
+        } while (missed != 0);
+    }
+    // Both of the above; false if another thread owns the drain.
+    template <typename Pass>
+    bool drain(Pass&& pass)
+    {
+        if (!enter())
+        {
+            return false;
+        }
+        run(std::forward<Pass>(pass));
+        return true;
+    }
+};
+
+// Hands a value to a user callback, as an rvalue when the callback can take
+// one so that values move along the pipeline instead of being copied.
+template <typename Handler, typename V, typename... Rest>
+void callWithValue(Handler& handler, V&& v, Rest&&... rest)
+{
+    if constexpr (std::is_invocable_v<Handler&, V&&, Rest&&...>)
+    {
+        handler(std::forward<V>(v), std::forward<Rest>(rest)...);
+    }
+    else
+    {
+        handler(v, std::forward<Rest>(rest)...);
+    }
+}
+
+// Fused stages compose map/filter functions statically. Each stage is called
+// with a value and an emitter and returns whether the value reached the
+// emitter, so a rejected element can be replaced by a request for the next one.
+struct FusedIdentity
+{
+    template <typename V, typename Emit>
+    bool operator()(V&& v, Emit&& emit)
+    {
+        return emit(std::forward<V>(v));
+    }
+};
+template <typename Prev, typename Func>
+struct FusedMap
+{
+    Prev prev;
+    Func func;
+    template <typename V, typename Emit>
+    bool operator()(V&& v, Emit&& emit)
+    {
+        return prev(std::forward<V>(v), [&](auto&& x) {
+            return emit(func(std::forward<decltype(x)>(x)));
+        });
+    }
+};
+template <typename Prev, typename Pred>
+struct FusedFilter
+{
+    Prev prev;
+    Pred pred;
+    template <typename V, typename Emit>
+    bool operator()(V&& v, Emit&& emit)
+    {
+        return prev(std::forward<V>(v), [&](auto&& x) {
+            if (!pred(x))
+            {
+                return false;
+            }
+            return emit(std::forward<decltype(x)>(x));
+        });
+    }
+};
+
+// A map/filter chain collapsed into one statically typed callable. The only
+// type erasure left is the std::function the root stores for the final
+// subscriber.
+template <typename Root, typename T, typename Stage = FusedIdentity>
+struct Fused
+{
+    using value_type = T;
+    using root_value_type = typename Root::value_type;
+    Root* root{nullptr};
+    Stage stage;
+
+    auto map(MapFunction<T> auto mapFun)
+    {
+        using FuncType = decltype(mapFun);
+        using DestType = std::invoke_result_t<FuncType, T>;
+        using NewStage = FusedMap<Stage, FuncType>;
+        return Fused<Root, DestType, NewStage>{
+            root, NewStage{std::move(stage), std::move(mapFun)}};
+    }
+    auto filter(FilterFunction<T> auto filtFun)
+    {
+        using NewStage = FusedFilter<Stage, decltype(filtFun)>;
+        return Fused<Root, T, NewStage>{
+            root, NewStage{std::move(stage), std::move(filtFun)}};
+    }
+    Disposable subscribe(SyncSubScribeFunction<T> auto handler)
+    {
+        return root->subscribe([stage = std::move(stage),
+                                handler = std::move(handler)](
+                                   root_value_type&& v) mutable {
+            stage(std::move(v), [&handler](auto&& out) {
+                callWithValue(handler, std::forward<decltype(out)>(out));
+                return true;
+            });
+        });
+    }
+    Disposable subscribe(AsyncSubScribeFunction<T> auto handler)
+    {
+        return root->subscribe(
+            [stage = std::move(stage), handler = std::move(handler)](
+                root_value_type&& v, auto&& reqNext) mutable {
+            bool emitted =
+                stage(std::move(v), [&handler, &reqNext](auto&& out) {
+                callWithValue(handler, std::forward<decltype(out)>(out),
+                              std::move(reqNext));
+                return true;
+            });
+            if (!emitted)
+            {
+                reqNext(true);
+            }
+        });
+    }
+};
+
+template <typename SrcType, typename DestType, typename ParentAdapter,
+          bool Filterer = false>
+struct Adapter;
+template <typename T, typename ParentAdapter>
+struct PublishOn;
+template <typename T, typename ParentAdapter>
+struct SubscribeOn;
+template <typename Parent, typename T, typename Stage>
+struct Parallel;
+template <typename T, typename ParentAdapter, typename Func>
+struct FlatMap;
+template <typename P>
+struct InnerPublisher;
+template <typename T>
+struct FluxBase;
+template <typename T, typename ParentAdapter, typename Boundary>
+struct Buffer;
+template <typename T>
+class Multicast;
+template <typename T>
+class MonoCache;
+template <typename T, typename ParentAdapter>
+struct Window;
+template <typename T, typename ParentAdapter>
+struct DelayElements;
+template <typename T, typename ParentAdapter>
+struct Timeout;
+template <typename T, typename ParentAdapter>
+struct Sample;
+template <typename T, typename ParentAdapter>
+struct Debounce;
+template <typename T, typename ParentAdapter>
+struct BufferTimeout;
+template <typename SrcType, typename DestType, typename ParentAdapter>
+struct TryMap;
+template <typename T, typename ParentAdapter>
+struct OnError;
+template <typename T, typename ParentAdapter, typename KeyFn>
+struct GroupBy;
+
+// Settings for groupBy(); see GroupBy.
+struct GroupByOptions
+{
+    // Live groups at most; the table is sized for this up front.
+    std::size_t maxGroups{1024};
+    // Groups that got no value for this long are completed. Zero keeps
+    // them until the upstream finishes or the table needs room.
+    TimerWheel::Duration idleTimeout{};
+    // Values queued in one group before the upstream is held back.
+    std::size_t prefetch{32};
+    // Groups are spread over these by key hash and deliver there. Without
+    // executors groups deliver inline.
+    std::vector<net::any_io_executor> executors;
+    // Runs the idle timeout while the upstream is quiet; the first of
+    // executors if unset. Without either, idle groups are only found when
+    // the next value arrives.
+    net::any_io_executor timerExecutor;
 };
+
 template <typename T, typename SelfType>
 struct SubscriberType : SubscriberBase
 {
     using Base = SubscriberBase;
     using value_type = T;
 
+    // Values travel as rvalues from the source to the subscriber, so
+    // move-only types work and nothing is copied on the way.
     using AsyncSubscriber =
-        std::function<void(const value_type&, CompletionToken&&)>;
-    using SyncSubscriber = std::function<void(const value_type&)>;
+        std::function<void(value_type&&, CompletionToken&&)>;
+    using SyncSubscriber = std::function<void(value_type&&)>;
     using Subscriber = std::variant<SyncSubscriber, AsyncSubscriber>;
     Subscriber subscriber;
     SelfType& self()
     {
         return *static_cast<SelfType*>(this);
     }
-    void invokeSubscriber(const value_type& r, AsyncSubscriber& handler)
+    // Handlers that only take lvalues (auto& v) get a thin wrapper.
+    template <typename Handler>
+    void setSubscriber(Handler handler)
     {
-        handler(r, [this](bool next) {
-            if (next)
+        if constexpr (AsyncSubScribeFunction<Handler, T>)
+        {
+            if constexpr (std::is_invocable_v<Handler&, T&&, CompletionToken&&>)
             {
-                self().subscribe(
-                    std::move(std::get<AsyncSubscriber>(subscriber)));
+                subscriber = AsyncSubscriber(std::move(handler));
             }
-        });
+            else
+            {
+                subscriber = AsyncSubscriber(
+                    [h = std::move(handler)](T&& v,
+                                             CompletionToken&& t) mutable {
+                    h(v, std::move(t));
+                });
+            }
+        }
+        else
+        {
+            if constexpr (std::is_invocable_v<Handler&, T&&>)
+            {
+                subscriber = SyncSubscriber(std::move(handler));
+            }
+            else
+            {
+                subscriber = SyncSubscriber(
+                    [h = std::move(handler)](T&& v) mutable { h(v); });
+            }
+        }
+    }
+    void release() override
+    {
+        subscriber = Subscriber{};
+    }
+    // The error signal. An error carries the token of the upstream that
+    // failed: asking it for more tries again (retryWhen), cancelling it gives
+    // up on it (onErrorResume). Errors are plain error codes handed from
+    // stage to stage; nothing is thrown.
+    using ErrorSink =
+        std::function<void(const beast::error_code&, CompletionToken&&)>;
+    ErrorSink errorSink;
+    // Sends an error to the stage subscribed to this one; at the end of the
+    // chain the root fails the whole flux (FluxBase::onError).
+    void error(const beast::error_code& ec, CompletionToken&& upstream) noexcept
+    {
+        if (errorSink)
+        {
+            errorSink(ec, std::move(upstream));
+            return;
+        }
+        self().rootAdaptee()->terminate(ec);
+    }
+    // Stages call this when they subscribe to their source. Errors from
+    // upstream reach onUpstreamError, which passes them on unless the stage
+    // deals with errors itself.
+    template <typename Upstream>
+    void listenForErrors(Upstream* upstream)
+    {
+        upstream->errorSink = [this](const beast::error_code& ec,
+                                     CompletionToken&& token) {
+            self().onUpstreamError(ec, std::move(token));
+        };
+    }
+    void onUpstreamError(const beast::error_code& ec,
+                         CompletionToken&& token) noexcept
+    {
+        error(ec, std::move(token));
     }
-    void invokeSubscriber(const value_type& r, SyncSubscriber& handler)
+    // Delivers one value downstream. The token is how the subscriber asks
+    // for the next value; sync subscribers ask implicitly once they return.
+    // A released stage swallows what is still in flight.
+    void invokeSubscriber(value_type&& r, AsyncSubscriber& handler,
+                          CompletionToken&& reqNext)
     {
-        handler(r);
-        self().subscribe(std::move(handler));
+        if (handler)
+        {
+            handler(std::move(r), std::move(reqNext));
+        }
     }
-    void visit(const value_type& r)
+    void invokeSubscriber(value_type&& r, SyncSubscriber& handler,
+                          CompletionToken&& reqNext)
     {
-        std::visit([&r, this](auto& handler) { invokeSubscriber(r, handler); },
-                   subscriber);
+        if (handler)
+        {
+            handler(std::move(r));
+            reqNext(true);
+        }
     }
-    void visit()
+    void visit(value_type&& r, CompletionToken&& reqNext)
     {
         std::visit(
-            [this](auto& handler) { invokeSubscriberWithNoValue(handler); },
+            [&r, &reqNext, this](auto& handler) {
+            invokeSubscriber(std::move(r), handler, std::move(reqNext));
+        },
             subscriber);
     }
-    void invokeSubscriberWithNoValue(auto& handler)
+    void visit(const value_type& r, CompletionToken&& reqNext)
     {
-        self().subscribe(std::move(handler));
+        visit(value_type(r), std::move(reqNext));
     }
     auto to(SyncSubScribeFunction<T> auto&& sub)
     {
         auto* ptrFun = &sub;
-        auto wrapper = [ptrFun](const T& data) { (*ptrFun)(data); };
+        auto wrapper = [ptrFun](T&& data) {
+            callWithValue(*ptrFun, std::move(data));
+        };
         self().subscribe(std::move(wrapper));
         return std::move(sub);
     }
+    auto fuse()
+    {
+        return Fused<SelfType, T>{&self(), FusedIdentity{}};
+    }
+    auto& map(MapFunction<T> auto mapFun)
+    {
+        using FuncType = decltype(mapFun);
+        using DestType = std::invoke_result_t<FuncType, T>;
+        using Stage = Adapter<T, DestType, SelfType>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            std::move(mapFun), &self());
+    }
+    auto& filter(FilterFunction<T> auto filtFun)
+    {
+        auto identityfunc = [](T&& v) -> T { return std::move(v); };
+        using Stage = Adapter<T, T, SelfType, true>;
+        auto& adapter = self().rootAdaptee()->template makeStage<Stage>(
+            std::move(identityfunc), &self());
+        adapter.setFilter(std::move(filtFun));
+        return adapter;
+    }
+    // A map that can fail: mapFun returns std::expected, and an unexpected
+    // error code goes down the error channel instead of a value.
+    template <typename Func>
+    auto& tryMap(Func mapFun)
+    {
+        using DestType = typename std::invoke_result_t<Func&, T&&>::value_type;
+        using Stage = TryMap<T, DestType, SelfType>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            std::move(mapFun), &self());
+    }
+    // Error operators; they act on errors raised upstream of them. See
+    // OnError.
+    auto& doOnError(std::function<void(const beast::error_code&)> observer)
+    {
+        return onErrorStage([observer = std::move(observer)](
+                                auto& stage, const beast::error_code& ec,
+                                CompletionToken&& token) {
+            observer(ec);
+            stage.error(ec, std::move(token));
+        });
+    }
+    // Completes the flux with a last value instead of failing.
+    auto& onErrorReturn(T fallback)
+    {
+        return onErrorStage([fallback = std::move(fallback)](
+                                auto& stage, const beast::error_code&,
+                                CompletionToken&& token) {
+            token.cancel();
+            stage.finishWith(T(fallback));
+        });
+    }
+    // Carries on with the publisher fallback(ec) returns (a Flux, a Mono or
+    // a shared_ptr to one) and completes when that does.
+    template <typename Func>
+    auto& onErrorResume(Func fallback)
+    {
+        using Inner = InnerPublisher<
+            std::invoke_result_t<Func&, const beast::error_code&>>;
+        return onErrorStage([fallback = std::move(fallback)](
+                                auto& stage, const beast::error_code& ec,
+                                CompletionToken&& token) mutable {
+            token.cancel();
+            stage.resumeWith(Inner::share(fallback(ec)));
+        });
+    }
+    // Asks the failed upstream again after the delay when(ec, attempt)
+    // returns, or passes the error on when it returns nullopt. Attempts
+    // count consecutive failures; a value getting through resets them. A
+    // failed source is pulled again (an HTTP source repeats its request);
+    // a failed stage such as tryMap drops the value and takes the next.
+    auto& retryWhen(net::any_io_executor executor,
+                    std::function<std::optional<TimerWheel::Duration>(
+                        const beast::error_code&, std::size_t)>
+                        when)
+    {
+        return onErrorStage([executor = std::move(executor),
+                             when = std::move(when)](
+                                auto& stage, const beast::error_code& ec,
+                                CompletionToken&& token) {
+            auto delay = when(ec, ++stage.attempts);
+            if (!delay)
+            {
+                stage.error(ec, std::move(token));
+                return;
+            }
+            if (*delay <= TimerWheel::Duration::zero())
+            {
+                token.request(1);
+                return;
+            }
+            stage.timer = TimerWheel::of(executor).schedule(
+                *delay, executor, [token = std::move(token)]() {
+                token.request(1);
+            });
+        });
+    }
+    auto& publishOn(net::any_io_executor executor, std::size_t prefetch = 32)
+    {
+        using Stage = PublishOn<T, SelfType>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            &self(), std::move(executor), prefetch);
+    }
+    auto& publishOn(net::thread_pool& pool, std::size_t prefetch = 32)
+    {
+        return publishOn(pool.get_executor(), prefetch);
+    }
+    auto& subscribeOn(net::any_io_executor executor)
+    {
+        using Stage = SubscribeOn<T, SelfType>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            &self(), std::move(executor));
+    }
+    auto& subscribeOn(net::thread_pool& pool)
+    {
+        return subscribeOn(pool.get_executor());
+    }
+    // Subscribes to the publisher returned by mapFun for every value, with
+    // at most maxConcurrency of them active; see FlatMap.
+    template <typename Func>
+    auto& flatMap(Func mapFun, std::size_t maxConcurrency = 32)
+    {
+        using Stage = FlatMap<T, SelfType, Func>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            &self(), std::move(mapFun), maxConcurrency);
+    }
+    template <typename Func>
+    auto& concatMap(Func mapFun)
+    {
+        return flatMap(std::move(mapFun), 1);
+    }
+    // Batches of up to maxSize values as spans over a reused buffer; see
+    // Buffer for how long a span stays valid.
+    auto& buffer(std::size_t maxSize)
+    {
+        maxSize = std::max<std::size_t>(maxSize, 1);
+        auto full = [maxSize](const T&, std::size_t n) {
+            return n >= maxSize;
+        };
+        using Stage = Buffer<T, SelfType, decltype(full)>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            &self(), std::move(full), maxSize);
+    }
+    // Batches that end with the first value matching pred, inclusive.
+    auto& bufferUntil(FilterFunction<T> auto pred)
+    {
+        auto last = [pred = std::move(pred)](const T& v, std::size_t) {
+            return pred(v);
+        };
+        using Stage = Buffer<T, SelfType, decltype(last)>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            &self(), std::move(last), 0);
+    }
+    // The last `size` values, every `step` values.
+    auto& window(std::size_t size, std::size_t step = 1)
+    {
+        using Stage = Window<T, SelfType>;
+        return self().rootAdaptee()->template makeStage<Stage>(&self(), size,
+                                                               step);
+    }
+    // Multicasting: every subscriber takes its own Flux from the returned
+    // hub's asFlux() while the upstream is subscribed only once; see
+    // Multicast. publish() and replay() wait for connect(), share() and
+    // cache() connect when the first subscriber asks for a value. replay
+    // and cache hand the last `history` values to late subscribers.
+    auto publish(std::size_t capacity = 32)
+    {
+        return multicast(0, capacity, false);
+    }
+    auto share(std::size_t capacity = 32)
+    {
+        return multicast(0, capacity, true);
+    }
+    auto replay(std::size_t history, std::size_t capacity = 32)
+    {
+        return multicast(history, capacity, false);
+    }
+    auto cache(std::size_t history = 1, std::size_t capacity = 32)
+    {
+        return multicast(history, capacity, true);
+    }
+    // Time-based operators; timers come from the TimerWheel shared by the
+    // executor's context and fire on the executor.
+    auto& delayElements(net::any_io_executor executor,
+                        TimerWheel::Duration delay)
+    {
+        using Stage = DelayElements<T, SelfType>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            &self(), std::move(executor), delay);
+    }
+    // Fails with beast::error::timeout after `limit` without a value.
+    auto& timeout(net::any_io_executor executor, TimerWheel::Duration limit)
+    {
+        using Stage = Timeout<T, SelfType>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            &self(), std::move(executor), limit);
+    }
+    auto& sample(net::any_io_executor executor, TimerWheel::Duration period)
+    {
+        using Stage = Sample<T, SelfType>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            &self(), std::move(executor), period);
+    }
+    auto& debounce(net::any_io_executor executor, TimerWheel::Duration quiet)
+    {
+        using Stage = Debounce<T, SelfType>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            &self(), std::move(executor), quiet);
+    }
+    auto& bufferTimeout(net::any_io_executor executor, std::size_t maxSize,
+                        TimerWheel::Duration maxWait)
+    {
+        using Stage = BufferTimeout<T, SelfType>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            &self(), std::move(executor), maxSize, maxWait);
+    }
+    // One GroupedFlux per key keyFn returns; see GroupBy.
+    template <typename KeyFn>
+    auto& groupBy(KeyFn keyFn, GroupByOptions options = {})
+    {
+        using Stage = GroupBy<T, SelfType, KeyFn>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            &self(), std::move(keyFn), std::move(options));
+    }
+    auto parallel(std::size_t rails)
+    {
+        return Parallel<SelfType, T, FusedIdentity>{
+            &self(), std::max<std::size_t>(rails, 1), {}, FusedIdentity{}};
+    }
+
+  private:
+    template <typename Policy>
+    auto& onErrorStage(Policy policy)
+    {
+        using Stage = OnError<T, SelfType>;
+        return self().rootAdaptee()->template makeStage<Stage>(
+            &self(), std::move(policy));
+    }
+    auto multicast(std::size_t history, std::size_t capacity, bool autoConnect)
+    {
+        auto hub =
+            std::make_shared<Multicast<T>>(history, capacity, autoConnect);
+        hub->from(&self(), self().rootAdaptee()->weak_from_this().lock());
+        return hub;
+    }
 };
 
 template <typename SrcType, typename DestType, typename ParentAdapter,
-          bool Filterer = false>
+          bool Filterer>
 struct Adapter :
     SubscriberType<DestType,
-                   Adapter<SrcType, DestType, ParentAdapter, Filterer>>
+                   Adapter<SrcType, DestType, ParentAdapter, Filterer>>,
+    ArenaStage
 {
     struct LazyAdaptee
     {
-        Adapter adapter;
+        Adapter* adapter;
         std::shared_ptr<SubscriberBase> ownerAdaptee;
-        void subscribe(auto handler)
+        Disposable subscribe(auto handler)
         {
-            adapter.subscribe(std::move(handler));
+            return adapter->subscribe(std::move(handler));
         }
     };
-    using AdaptFuncion = std::function<DestType(const SrcType&)>;
+    using AdaptFuncion = std::function<DestType(SrcType&&)>;
     using FilterHandler = std::function<bool(const SrcType&)>;
 
     using Base =
@@ -97,52 +808,46 @@ struct Adapter :
         filterFunc = std::move(filt);
     }
 
-    void operator()(const SrcType& res, auto&& reqNext)
+    void operator()(SrcType&& res, auto&& reqNext)
     {
         if constexpr (Filterer)
         {
-            if (filterFunc(res))
+            if (filterFunc(std::as_const(res)))
             {
-                Base::visit(res);
+                Base::visit(std::move(res), std::move(reqNext));
             }
             else
             {
-                Base::visit();
+                reqNext(true);
             }
         }
         else
         {
-            Base::visit(adaptFunc(res));
+            Base::visit(adaptFunc(std::move(res)), std::move(reqNext));
         }
     }
-    void subscribe(SyncSubScribeFunction<DestType> auto handler)
+    Disposable subscribe(SyncSubScribeFunction<DestType> auto handler)
     {
-        Base::subscriber = std::move(handler);
-        src->subscribe(*this);
+        Base::setSubscriber(std::move(handler));
+        return subscribeToSource();
     }
-    void subscribe(AsyncSubScribeFunction<DestType> auto handler)
+    Disposable subscribe(AsyncSubScribeFunction<DestType> auto handler)
     {
-        Base::subscriber = std::move(handler);
-        src->subscribe(*this);
+        Base::setSubscriber(std::move(handler));
+        return subscribeToSource();
     }
-
-    auto map(MapFunction<DestType> auto mapFun)
+    void release() override
     {
-        using FuncType = decltype(mapFun);
-        using NewDestType = std::invoke_result_t<FuncType, DestType>;
-        auto adapter = new Adapter<DestType, NewDestType, Adapter>(
-            std::move(mapFun), this);
-        adapter->rootAdaptee()->addToMappers(adapter);
-        return *adapter;
+        Base::release();
+        adaptFunc = nullptr;
+        filterFunc = nullptr;
     }
-    auto filter(FilterFunction<DestType> auto filtFun)
+    Disposable subscribeToSource()
     {
-        auto identityfunc = [](const DestType& v) { return v; };
-        auto adapter = new Adapter<DestType, DestType, Adapter, true>(
-            std::move(identityfunc), this);
-        adapter->setFilter(std::move(filtFun));
-        adapter->rootAdaptee()->addToMappers(adapter);
-        return *adapter;
+        Base::listenForErrors(src);
+        return src->subscribe([this](SrcType&& res, auto&& reqNext) {
+            (*this)(std::move(res), std::move(reqNext));
+        });
     }
     auto rootAdaptee()
     {
@@ -150,262 +855,3810 @@ struct Adapter :
     }
     auto makeLazy()
     {
-        return LazyAdaptee{*this, rootAdaptee()->getSharedPtr()};
+        return LazyAdaptee{this, rootAdaptee()->getSharedPtr()};
     }
 };
 
-template <typename T>
-struct FluxBase : SubscriberType<T, FluxBase<T>>
+// map() for functions that return std::expected. A value that fails to map
+// is dropped and its error code goes down the error channel together with
+// the upstream token, so a retry carries on with the next value.
+template <typename SrcType, typename DestType, typename ParentAdapter>
+struct TryMap :
+    SubscriberType<DestType, TryMap<SrcType, DestType, ParentAdapter>>,
+    ArenaStage
 {
-    using value_type = T;
-    using Base = SubscriberType<T, FluxBase<T>>;
-
-    struct SourceHandler
-    {
-        virtual void next(std::function<void(T)> consumer) = 0;
-        virtual bool hasNext() const = 0;
-        virtual ~SourceHandler() {}
-    };
-
-  protected:
-    explicit FluxBase(SourceHandler* srcHandler) : mSource(srcHandler) {}
-    std::unique_ptr<SourceHandler> mSource{};
-    std::function<void()> onFinishHandler{};
-    std::vector<std::unique_ptr<SubscriberBase>> mapHandlers;
-    SourceHandler* source() const
+    using Base =
+        SubscriberType<DestType, TryMap<SrcType, DestType, ParentAdapter>>;
+    using TryFunction =
+        std::function<std::expected<DestType, beast::error_code>(SrcType&&)>;
+    TryFunction tryFunc;
+    ParentAdapter* src{nullptr};
+    TryMap(TryFunction func, ParentAdapter* s) : tryFunc(std::move(func)), src(s)
+    {}
+    Disposable subscribe(auto handler)
     {
-        return mSource.get();
+        Base::setSubscriber(std::move(handler));
+        Base::listenForErrors(src);
+        return src->subscribe([this](SrcType&& v, auto&& reqNext) {
+            auto result = tryFunc(std::move(v));
+            if (!result)
+            {
+                Base::error(result.error(), std::move(reqNext));
+                return;
+            }
+            Base::visit(std::move(*result), std::move(reqNext));
+        });
     }
-
-  public:
-    void subscribe(auto handler)
+    void release() override
     {
-        Base::subscriber = std::move(handler);
-        if (mSource->hasNext())
+        Base::release();
+        tryFunc = nullptr;
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+};
+
+// Values pass straight through; errors raised upstream go to the policy the
+// error operator installed (doOnError, onErrorReturn, onErrorResume,
+// retryWhen), which passes them on, finishes the flux or tries again.
+template <typename T, typename ParentAdapter>
+struct OnError : SubscriberType<T, OnError<T, ParentAdapter>>, ArenaStage
+{
+    using Base = SubscriberType<T, OnError<T, ParentAdapter>>;
+    using Policy = std::function<void(OnError&, const beast::error_code&,
+                                      CompletionToken&&)>;
+    ParentAdapter* src{nullptr};
+    Policy policy;
+    std::size_t attempts{0};
+    TimerWheel::Handle timer;
+    std::shared_ptr<FluxBase<T>> fallback;
+
+    OnError(ParentAdapter* s, Policy p) : src(s), policy(std::move(p)) {}
+    Disposable subscribe(auto handler)
+    {
+        Base::setSubscriber(std::move(handler));
+        Base::listenForErrors(src);
+        return src->subscribe([this](T&& v, auto&& reqNext) {
+            attempts = 0;
+            Base::visit(std::move(v), std::move(reqNext));
+        });
+    }
+    // Once resumed, errors come from the fallback and pass on.
+    void onUpstreamError(const beast::error_code& ec,
+                         CompletionToken&& token) noexcept
+    {
+        if (fallback)
+        {
+            Base::error(ec, std::move(token));
+            return;
+        }
+        if (policy)
+        {
+            policy(*this, ec, std::move(token));
+        }
+    }
+    void finishWith(T&& last)
+    {
+        Base::visit(std::move(last), CompletionToken{});
+        rootAdaptee()->terminate();
+    }
+    // The fallback may be shared with its own onFinish and onError, so
+    // the stage hooks in beside them.
+    void resumeWith(std::shared_ptr<FluxBase<T>> next)
+    {
+        fallback = std::move(next);
+        Base::listenForErrors(fallback.get());
+        fallback->whenFinished([this]() { rootAdaptee()->terminate(); });
+        fallback->subscribe([this](T&& v, auto&& reqNext) {
+            Base::visit(std::move(v), std::move(reqNext));
+        });
+    }
+    void release() override
+    {
+        Base::release();
+        policy = nullptr;
+        timer.cancel();
+        if (fallback)
+        {
+            fallback->dispose();
+        }
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+};
+
+// Moves delivery downstream onto an executor. The upstream keeps running
+// where it was subscribed and fills a queue; a single drain task at a time
+// empties it, so values keep their order even on a multi-threaded pool. At
+// most `prefetch` values are requested ahead of the downstream, and the
+// upstream is topped up in batches as the queue drains. Completion waits
+// until the queue is empty. Posted work refers to the stage, so the
+// pipeline must outlive the executor's work.
+template <typename T, typename ParentAdapter>
+struct PublishOn :
+    SubscriberType<T, PublishOn<T, ParentAdapter>>,
+    Subscription,
+    ArenaStage
+{
+    using Base = SubscriberType<T, PublishOn<T, ParentAdapter>>;
+    ParentAdapter* src{nullptr};
+    net::any_io_executor executor;
+    std::size_t prefetch;
+    std::size_t limit;
+    std::mutex queueLock;
+    std::deque<T> queue;
+    CompletionToken upstream;
+    bool primed{false};
+    std::size_t consumed{0};
+    std::atomic<std::size_t> demand{0};
+    WorkInProgress wip;
+    std::atomic<bool> cancelled{false};
+
+    PublishOn(ParentAdapter* s, net::any_io_executor ex, std::size_t pf) :
+        src(s), executor(std::move(ex)), prefetch(std::max<std::size_t>(pf, 1)),
+        limit(prefetch - prefetch / 4)
+    {}
+    Disposable subscribe(auto handler)
+    {
+        Base::setSubscriber(std::move(handler));
+        demand = 1;
+        cancelled = false;
+        Base::listenForErrors(src);
+        return src->subscribe([this](T&& v, auto&& reqNext) {
+            onUpstream(std::move(v), std::move(reqNext));
+        });
+    }
+    void onUpstream(T&& v, CompletionToken&& reqNext)
+    {
+        rootAdaptee()->holdFinish();
+        bool first = false;
+        {
+            std::lock_guard lock(queueLock);
+            queue.push_back(std::move(v));
+            upstream = reqNext;
+            first = !std::exchange(primed, true);
+        }
+        if (first && prefetch > 1)
+        {
+            reqNext.request(prefetch - 1);
+        }
+        schedule();
+    }
+    void request(std::size_t n) override
+    {
+        addDemand(demand, n);
+        schedule();
+    }
+    void cancel() override
+    {
+        cancelled = true;
+        upstreamToken().cancel();
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+
+  private:
+    CompletionToken upstreamToken()
+    {
+        std::lock_guard lock(queueLock);
+        return upstream;
+    }
+    std::optional<T> poll()
+    {
+        std::lock_guard lock(queueLock);
+        if (queue.empty())
+        {
+            return std::nullopt;
+        }
+        std::optional<T> v{std::move(queue.front())};
+        queue.pop_front();
+        return v;
+    }
+    void schedule()
+    {
+        if (wip.enter())
+        {
+            net::post(executor, [this]() { drain(); });
+        }
+    }
+    void drain()
+    {
+        auto* root = rootAdaptee();
+        std::size_t handed = 0;
+        wip.run([this, &handed]() {
+            while (!cancelled && demand > 0)
+            {
+                auto v = poll();
+                if (!v)
+                {
+                    break;
+                }
+                --demand;
+                ++handed;
+                Base::visit(std::move(*v), CompletionToken(this));
+                if (++consumed == limit)
+                {
+                    consumed = 0;
+                    upstreamToken().request(limit);
+                }
+            }
+        });
+        root->releaseFinish(handed);
+    }
+};
+
+// Runs the subscription, and every later request upstream, on an executor.
+// Requests made from within the executor are dispatched inline.
+template <typename T, typename ParentAdapter>
+struct SubscribeOn :
+    SubscriberType<T, SubscribeOn<T, ParentAdapter>>,
+    Subscription,
+    ArenaStage
+{
+    using Base = SubscriberType<T, SubscribeOn<T, ParentAdapter>>;
+    ParentAdapter* src{nullptr};
+    net::any_io_executor executor;
+    std::mutex tokenLock;
+    CompletionToken upstream;
+
+    SubscribeOn(ParentAdapter* s, net::any_io_executor ex) :
+        src(s), executor(std::move(ex))
+    {}
+    Disposable subscribe(auto handler)
+    {
+        Base::setSubscriber(std::move(handler));
+        net::post(executor, [this]() {
+            Base::listenForErrors(src);
+            src->subscribe([this](T&& v, auto&& reqNext) {
+                {
+                    std::lock_guard lock(tokenLock);
+                    upstream = reqNext;
+                }
+                Base::visit(std::move(v), CompletionToken(this));
+            });
+        });
+        return Disposable(rootAdaptee());
+    }
+    void request(std::size_t n) override
+    {
+        net::dispatch(executor,
+                      [up = upstreamToken(), n]() { up.request(n); });
+    }
+    void cancel() override
+    {
+        net::dispatch(executor, [up = upstreamToken()]() { up.cancel(); });
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+
+  private:
+    CompletionToken upstreamToken()
+    {
+        std::lock_guard lock(tokenLock);
+        return upstream;
+    }
+};
+
+// Splits the values of ParentAdapter over a number of rails and joins the
+// results back into one stream. Every rail is a strand on the executor with
+// its own copy of the fused map/filter chain, so rail functions never run
+// concurrently with themselves while idle pool threads pick up whichever
+// rail has work. At most rails * prefetch values are in flight; the
+// upstream is paused once the window is full and resumed as results are
+// delivered. Results land in a ring of window slots: Ordered slots them by
+// upstream sequence number, otherwise by completion order. Delivery
+// downstream, completion included, is serialized but happens on whichever
+// thread finished last.
+template <typename T, typename ParentAdapter, typename Stage, bool Ordered>
+struct ParallelJoin :
+    SubscriberType<T, ParallelJoin<T, ParentAdapter, Stage, Ordered>>,
+    Subscription,
+    ArenaStage
+{
+    using Base =
+        SubscriberType<T, ParallelJoin<T, ParentAdapter, Stage, Ordered>>;
+    using SrcType = typename ParentAdapter::value_type;
+    struct Rail
+    {
+        std::optional<net::strand<net::any_io_executor>> strand;
+        Stage stage;
+    };
+    struct Slot
+    {
+        std::optional<T> value;
+        bool ready{false};
+    };
+    ParentAdapter* src{nullptr};
+    std::vector<Rail> rails;
+    std::vector<Slot> slots;
+    std::mutex lock;
+    std::size_t nextSeq{0};
+    std::size_t arrived{0};
+    std::size_t head{0};
+    std::size_t inFlight{0};
+    std::optional<CompletionToken> paused;
+    std::atomic<std::size_t> demand{0};
+    WorkInProgress wip;
+    std::atomic<bool> cancelled{false};
+
+    ParallelJoin(ParentAdapter* s, std::size_t railCount,
+                 net::any_io_executor executor, Stage stage,
+                 std::size_t prefetch) :
+        src(s), slots(railCount * std::max<std::size_t>(prefetch, 1))
+    {
+        rails.reserve(railCount);
+        for (std::size_t i = 0; i < railCount; ++i)
+        {
+            Rail rail{std::nullopt, stage};
+            if (executor)
+            {
+                rail.strand.emplace(executor);
+            }
+            rails.push_back(std::move(rail));
+        }
+    }
+    Disposable subscribe(auto handler)
+    {
+        Base::setSubscriber(std::move(handler));
+        demand = 1;
+        cancelled = false;
+        Base::listenForErrors(src);
+        return src->subscribe([this](SrcType&& v, auto&& reqNext) {
+            onUpstream(std::move(v), std::move(reqNext));
+        });
+    }
+    void request(std::size_t n) override
+    {
+        addDemand(demand, n);
+        drain();
+    }
+    void cancel() override
+    {
+        cancelled = true;
+        std::optional<CompletionToken> up;
+        {
+            std::lock_guard guard(lock);
+            up = std::exchange(paused, std::nullopt);
+        }
+        if (up)
+        {
+            up->cancel();
+        }
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+
+  private:
+    void onUpstream(SrcType&& v, CompletionToken&& reqNext)
+    {
+        rootAdaptee()->holdFinish();
+        std::size_t seq = 0;
+        bool more = false;
+        {
+            std::lock_guard guard(lock);
+            seq = nextSeq++;
+            more = ++inFlight < slots.size();
+            if (!more)
+            {
+                paused = reqNext;
+            }
+        }
+        auto& rail = rails[seq % rails.size()];
+        auto work = [this, &rail, v = std::move(v), seq]() mutable {
+            process(rail, std::move(v), seq);
+        };
+        if (rail.strand)
+        {
+            net::post(*rail.strand, std::move(work));
+        }
+        else
+        {
+            work();
+        }
+        if (more)
+        {
+            reqNext(true);
+        }
+    }
+    void process(Rail& rail, SrcType&& v, std::size_t seq)
+    {
+        std::optional<T> result;
+        rail.stage(std::move(v), [&result](auto&& out) {
+            result.emplace(std::forward<decltype(out)>(out));
+            return true;
+        });
+        {
+            std::lock_guard guard(lock);
+            auto& slot = slots[(Ordered ? seq : arrived++) % slots.size()];
+            slot.value = std::move(result);
+            slot.ready = true;
+        }
+        drain();
+    }
+    // Takes the slot at the head once its value is in. Filtered values
+    // leave an empty slot behind that is skipped without using up demand.
+    std::optional<std::optional<T>> poll(bool canEmit)
+    {
+        std::lock_guard guard(lock);
+        auto& slot = slots[head % slots.size()];
+        if (!slot.ready || (slot.value && !canEmit))
+        {
+            return std::nullopt;
+        }
+        slot.ready = false;
+        ++head;
+        return std::exchange(slot.value, std::nullopt);
+    }
+    void freeSlot()
+    {
+        std::optional<CompletionToken> up;
+        {
+            std::lock_guard guard(lock);
+            --inFlight;
+            up = std::exchange(paused, std::nullopt);
+        }
+        if (up && !cancelled)
+        {
+            up->request(1);
+        }
+    }
+    void drain()
+    {
+        auto* root = rootAdaptee();
+        std::size_t freed = 0;
+        bool drained = wip.drain([this, &freed]() {
+            while (!cancelled)
+            {
+                auto slot = poll(demand > 0);
+                if (!slot)
+                {
+                    break;
+                }
+                if (*slot)
+                {
+                    --demand;
+                    Base::visit(std::move(**slot), CompletionToken(this));
+                }
+                freeSlot();
+                ++freed;
+            }
+        });
+        if (drained)
+        {
+            root->releaseFinish(freed);
+        }
+    }
+};
+
+// Builder returned by parallel(n). Rail map/filter calls compose statically
+// like fuse(); sequential() and ordered() close the rails into a regular
+// stage that the pipeline continues from.
+template <typename Parent, typename T, typename Stage>
+struct Parallel
+{
+    using value_type = T;
+    Parent* parent{nullptr};
+    std::size_t rails{1};
+    net::any_io_executor executor;
+    Stage stage;
+
+    Parallel runOn(net::any_io_executor ex) &&
+    {
+        executor = std::move(ex);
+        return std::move(*this);
+    }
+    Parallel runOn(net::thread_pool& pool) &&
+    {
+        return std::move(*this).runOn(pool.get_executor());
+    }
+    auto map(MapFunction<T> auto mapFun) &&
+    {
+        using FuncType = decltype(mapFun);
+        using DestType = std::invoke_result_t<FuncType, T>;
+        using NewStage = FusedMap<Stage, FuncType>;
+        return Parallel<Parent, DestType, NewStage>{
+            parent, rails, std::move(executor),
+            NewStage{std::move(stage), std::move(mapFun)}};
+    }
+    auto filter(FilterFunction<T> auto filtFun) &&
+    {
+        using NewStage = FusedFilter<Stage, decltype(filtFun)>;
+        return Parallel<Parent, T, NewStage>{
+            parent, rails, std::move(executor),
+            NewStage{std::move(stage), std::move(filtFun)}};
+    }
+    auto& sequential(std::size_t prefetch = 32) &&
+    {
+        return join<false>(prefetch);
+    }
+    auto& ordered(std::size_t prefetch = 32) &&
+    {
+        return join<true>(prefetch);
+    }
+
+  private:
+    template <bool Ordered>
+    auto& join(std::size_t prefetch)
+    {
+        using Join = ParallelJoin<T, Parent, Stage, Ordered>;
+        return parent->rootAdaptee()->template makeStage<Join>(
+            parent, rails, std::move(executor), std::move(stage), prefetch);
+    }
+};
+
+// Normalizes what a flatMap function returns: a Mono/Flux by value or a
+// shared_ptr to one (as WebClient::toMono() hands out).
+template <typename P>
+struct InnerPublisher
+{
+    using type = P;
+    static std::shared_ptr<P> share(P&& p)
+    {
+        return std::make_shared<P>(std::move(p));
+    }
+};
+template <typename P>
+struct InnerPublisher<std::shared_ptr<P>>
+{
+    using type = P;
+    static std::shared_ptr<P> share(std::shared_ptr<P> p)
+    {
+        return p;
+    }
+};
+
+// Maps every upstream value to an inner publisher and merges what the inners
+// emit. At most maxConcurrency inners are subscribed at once; the upstream is
+// paused while that many are active and resumed when one finishes. Each inner
+// has at most one value waiting here, which goes out once there is demand,
+// after which that inner is asked for its next value. With a concurrency of
+// one (concatMap) the output keeps upstream order.
+template <typename T, typename ParentAdapter, typename Func>
+struct FlatMap :
+    SubscriberType<
+        typename InnerPublisher<
+            std::invoke_result_t<Func, T>>::type::value_type,
+        FlatMap<T, ParentAdapter, Func>>,
+    Subscription,
+    ArenaStage
+{
+    using Inner = typename InnerPublisher<std::invoke_result_t<Func, T>>::type;
+    using value_type = typename Inner::value_type;
+    using Base = SubscriberType<value_type, FlatMap<T, ParentAdapter, Func>>;
+    ParentAdapter* src{nullptr};
+    Func func;
+    std::size_t maxConcurrency;
+    std::mutex lock;
+    std::vector<std::shared_ptr<Inner>> inners;
+    std::deque<std::pair<value_type, CompletionToken>> ready;
+    std::optional<CompletionToken> paused;
+    std::atomic<std::size_t> demand{0};
+    WorkInProgress wip;
+    std::atomic<bool> cancelled{false};
+
+    FlatMap(ParentAdapter* s, Func f, std::size_t concurrency) :
+        src(s), func(std::move(f)),
+        maxConcurrency(std::max<std::size_t>(concurrency, 1))
+    {}
+    Disposable subscribe(auto handler)
+    {
+        Base::setSubscriber(std::move(handler));
+        demand = 1;
+        cancelled = false;
+        Base::listenForErrors(src);
+        return src->subscribe([this](T&& v, auto&& reqNext) {
+            onUpstream(std::move(v), std::move(reqNext));
+        });
+    }
+    void request(std::size_t n) override
+    {
+        addDemand(demand, n);
+        drain();
+    }
+    void cancel() override
+    {
+        cancelled = true;
+        std::vector<std::shared_ptr<Inner>> active;
+        std::optional<CompletionToken> up;
+        {
+            std::lock_guard guard(lock);
+            active = inners;
+            up = std::exchange(paused, std::nullopt);
+        }
+        for (auto& inner : active)
+        {
+            inner->cancel();
+        }
+        if (up)
+        {
+            up->cancel();
+        }
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+
+  private:
+    void onUpstream(T&& v, CompletionToken&& reqNext)
+    {
+        auto inner = InnerPublisher<std::invoke_result_t<Func, T>>::share(
+            func(std::move(v)));
+        bool more = false;
+        {
+            std::lock_guard guard(lock);
+            inners.push_back(inner);
+            more = inners.size() < maxConcurrency;
+            if (!more)
+            {
+                paused = reqNext;
+            }
+        }
+        inner->whenFinished([this, raw = inner.get()]() { onInnerDone(raw); });
+        inner->subscribe(
+            [this](value_type&& x, auto&& innerNext) {
+            {
+                std::lock_guard guard(lock);
+                ready.emplace_back(std::move(x), innerNext);
+            }
+            drain();
+        });
+        if (more)
+        {
+            reqNext(true);
+        }
+    }
+    void onInnerDone(Inner* raw)
+    {
+        std::shared_ptr<Inner> done;
+        std::optional<CompletionToken> up;
+        {
+            std::lock_guard guard(lock);
+            auto it =
+                std::ranges::find(inners, raw, &std::shared_ptr<Inner>::get);
+            if (it != inners.end())
+            {
+                done = std::move(*it);
+                inners.erase(it);
+            }
+            up = std::exchange(paused, std::nullopt);
+        }
+        if (up && !cancelled)
+        {
+            up->request(1);
+        }
+    }
+    std::optional<std::pair<value_type, CompletionToken>> poll()
+    {
+        std::lock_guard guard(lock);
+        if (ready.empty())
+        {
+            return std::nullopt;
+        }
+        std::optional<std::pair<value_type, CompletionToken>> v{
+            std::move(ready.front())};
+        ready.pop_front();
+        return v;
+    }
+    void drain()
+    {
+        wip.drain([this]() {
+            while (!cancelled && demand > 0)
+            {
+                auto entry = poll();
+                if (!entry)
+                {
+                    break;
+                }
+                --demand;
+                Base::visit(std::move(entry->first), CompletionToken(this));
+                entry->second.request(1);
+            }
+        });
+    }
+};
+
+// Collects values into a buffer owned by the stage and hands the filled
+// part downstream as a span, so once the buffer has grown batches cost no
+// allocation. Boundary is asked after every value whether the batch is
+// complete. The span is only valid until the next batch is started, after
+// which the buffer is reused: copy out what has to live longer, and do not
+// queue spans (publishOn) behind this stage. A complete batch waits for
+// demand; with demand left over the next one is started right after the
+// subscriber returns. A partial batch is flushed when the flux finishes.
+template <typename T, typename ParentAdapter, typename Boundary>
+struct Buffer :
+    SubscriberType<std::span<const T>, Buffer<T, ParentAdapter, Boundary>>,
+    Subscription,
+    ArenaStage
+{
+    using Base =
+        SubscriberType<std::span<const T>, Buffer<T, ParentAdapter, Boundary>>;
+    ParentAdapter* src{nullptr};
+    Boundary boundary;
+    std::vector<T> buffer;
+    CompletionToken upstream;
+    std::atomic<std::size_t> demand{0};
+    bool held{false};
+    bool emitting{false};
+
+    Buffer(ParentAdapter* s, Boundary b, std::size_t sizeHint) :
+        src(s), boundary(std::move(b))
+    {
+        buffer.reserve(sizeHint);
+        rootAdaptee()->whenFinished([this]() {
+            if (!emitting && !buffer.empty())
+            {
+                emit();
+            }
+        });
+    }
+    Disposable subscribe(auto handler)
+    {
+        Base::setSubscriber(std::move(handler));
+        buffer.clear();
+        demand = 1;
+        held = emitting = false;
+        Base::listenForErrors(src);
+        return src->subscribe([this](T&& v, auto&& reqNext) {
+            upstream = reqNext;
+            buffer.push_back(std::move(v));
+            if (boundary(std::as_const(buffer.back()), buffer.size()))
+            {
+                held = demand == 0;
+                if (!held)
+                {
+                    emit();
+                }
+                return;
+            }
+            reqNext(true);
+        });
+    }
+    void request(std::size_t n) override
+    {
+        addDemand(demand, n);
+        if (std::exchange(held, false))
+        {
+            emit();
+        }
+        else if (emitting)
+        {
+            next();
+        }
+    }
+    void cancel() override
+    {
+        upstream.cancel();
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+
+  private:
+    // The flush on finish goes out even without demand.
+    void emit()
+    {
+        if (demand > 0)
+        {
+            --demand;
+        }
+        emitting = true;
+        Base::visit(std::span<const T>(buffer), CompletionToken(this));
+        if (emitting && demand > 0)
+        {
+            next();
+        }
+    }
+    void next()
+    {
+        emitting = false;
+        buffer.clear();
+        upstream.request(1);
+    }
+};
+
+// Sliding window over the last `size` values, handed out as a span every
+// `step` values once the window is full. Values live in one buffer of twice
+// the window size that is compacted when it fills up, so sliding costs a
+// move per value on average. The same lifetime and demand rules as for
+// Buffer apply. When the flux finishes, values no window has covered yet go
+// out in one last, possibly short, window.
+template <typename T, typename ParentAdapter>
+struct Window :
+    SubscriberType<std::span<const T>, Window<T, ParentAdapter>>,
+    Subscription,
+    ArenaStage
+{
+    using Base = SubscriberType<std::span<const T>, Window<T, ParentAdapter>>;
+    ParentAdapter* src{nullptr};
+    std::size_t size;
+    std::size_t step;
+    std::vector<T> storage;
+    std::size_t first{0};
+    std::size_t uncovered{0};
+    bool full{false};
+    CompletionToken upstream;
+    std::atomic<std::size_t> demand{0};
+    bool held{false};
+    bool emitting{false};
+
+    Window(ParentAdapter* s, std::size_t n, std::size_t k) :
+        src(s), size(std::max<std::size_t>(n, 1)),
+        step(std::max<std::size_t>(k, 1))
+    {
+        storage.reserve(2 * size);
+        rootAdaptee()->whenFinished([this]() {
+            if (uncovered > 0)
+            {
+                emit();
+            }
+        });
+    }
+    Disposable subscribe(auto handler)
+    {
+        Base::setSubscriber(std::move(handler));
+        storage.clear();
+        first = uncovered = 0;
+        demand = 1;
+        full = held = emitting = false;
+        Base::listenForErrors(src);
+        return src->subscribe([this](T&& v, auto&& reqNext) {
+            upstream = reqNext;
+            push(std::move(v));
+            if (storage.size() - first == size &&
+                (!std::exchange(full, true) || uncovered >= step))
+            {
+                held = demand == 0;
+                if (!held)
+                {
+                    emit();
+                }
+                return;
+            }
+            reqNext(true);
+        });
+    }
+    void request(std::size_t n) override
+    {
+        addDemand(demand, n);
+        if (std::exchange(held, false))
+        {
+            emit();
+        }
+        else if (std::exchange(emitting, false))
+        {
+            upstream.request(1);
+        }
+    }
+    void cancel() override
+    {
+        upstream.cancel();
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+
+  private:
+    void push(T&& v)
+    {
+        if (storage.size() == storage.capacity())
+        {
+            std::move(storage.begin() + first, storage.end(), storage.begin());
+            storage.resize(storage.size() - first);
+            first = 0;
+        }
+        storage.push_back(std::move(v));
+        ++uncovered;
+        if (storage.size() - first > size)
+        {
+            ++first;
+        }
+    }
+    void emit()
+    {
+        if (demand > 0)
+        {
+            --demand;
+        }
+        uncovered = 0;
+        emitting = true;
+        Base::visit(std::span<const T>(storage.data() + first,
+                                       storage.size() - first),
+                    CompletionToken(this));
+        if (demand > 0 && std::exchange(emitting, false))
+        {
+            upstream.request(1);
+        }
+    }
+};
+
+// Common ground for the time-based stages. Values bound for downstream are
+// queued and handed over by one thread at a time while there is demand, so
+// a timer firing on the executor never delivers concurrently with a value
+// arriving from upstream. Each stage has at most one timer pending on the
+// TimerWheel of its executor's context; onTimer() runs on the executor with
+// the state lock held. As with PublishOn, the pipeline must outlive the
+// work it has scheduled.
+template <typename T, typename Derived>
+struct TimedStage : SubscriberType<T, Derived>, Subscription, ArenaStage
+{
+    using Base = SubscriberType<T, Derived>;
+    using Duration = TimerWheel::Duration;
+    net::any_io_executor executor;
+    TimerWheel& wheel;
+    std::mutex stateLock;
+    std::deque<T> ready;
+    CompletionToken upstream;
+    TimerWheel::Handle timer;
+    std::size_t generation{0};
+    std::atomic<std::size_t> demand{0};
+    WorkInProgress wip;
+    std::atomic<bool> cancelled{false};
+
+    explicit TimedStage(net::any_io_executor ex) :
+        executor(std::move(ex)), wheel(TimerWheel::of(executor))
+    {}
+    // Wheel callbacks capture this stage; none may fire once it is gone.
+    ~TimedStage()
+    {
+        timer.cancel();
+    }
+    void request(std::size_t n) override
+    {
+        addDemand(demand, n);
+        drain();
+    }
+    void cancel() override
+    {
+        cancelled = true;
+        std::unique_lock guard(stateLock);
+        timer.cancel();
+        auto up = upstream;
+        guard.unlock();
+        up.cancel();
+    }
+    // A disposed pipeline has no one left to tell about the timer, and its
+    // root may go before the timer is due.
+    void release() override
+    {
+        cancelled = true;
+        {
+            std::lock_guard guard(stateLock);
+            timer.cancel();
+        }
+        Base::release();
+    }
+
+  protected:
+    void start()
+    {
+        demand = 1;
+        cancelled = false;
+    }
+    // Replaces the pending timer. Call with stateLock held.
+    void rearm(Duration delay)
+    {
+        timer.cancel();
+        timer = wheel.schedule(delay, executor,
+                               [this, gen = ++generation]() {
+            std::unique_lock guard(stateLock);
+            if (gen == generation && !cancelled)
+            {
+                static_cast<Derived&>(*this).onTimer(guard);
+            }
+        });
+    }
+    CompletionToken upstreamToken()
+    {
+        std::lock_guard guard(stateLock);
+        return upstream;
+    }
+    // Called by drain after every value handed downstream.
+    void delivered() {}
+    void drain()
+    {
+        wip.drain([this]() {
+            while (!cancelled && demand > 0)
+            {
+                auto v = poll();
+                if (!v)
+                {
+                    break;
+                }
+                --demand;
+                Base::visit(std::move(*v), CompletionToken(this));
+                static_cast<Derived&>(*this).delivered();
+            }
+        });
+    }
+
+  private:
+    std::optional<T> poll()
+    {
+        std::lock_guard guard(stateLock);
+        if (ready.empty())
+        {
+            return std::nullopt;
+        }
+        std::optional<T> v{std::move(ready.front())};
+        ready.pop_front();
+        return v;
+    }
+};
+
+// Holds every value back for a fixed delay. Demand passes straight through
+// to the upstream; since the delay is the same for all values, they leave
+// in the order they came.
+template <typename T, typename ParentAdapter>
+struct DelayElements : TimedStage<T, DelayElements<T, ParentAdapter>>
+{
+    using Timed = TimedStage<T, DelayElements<T, ParentAdapter>>;
+    friend Timed;
+    ParentAdapter* src{nullptr};
+    TimerWheel::Duration delay;
+    std::deque<T> delayed;
+    std::deque<TimerWheel::Handle> timers;
+
+    DelayElements(ParentAdapter* s, net::any_io_executor ex,
+                  TimerWheel::Duration d) :
+        Timed(std::move(ex)), src(s), delay(d)
+    {}
+    ~DelayElements()
+    {
+        cancelTimers();
+    }
+    Disposable subscribe(auto handler)
+    {
+        Timed::setSubscriber(std::move(handler));
+        Timed::start();
+        Timed::listenForErrors(src);
+        return src->subscribe([this](T&& v, auto&& reqNext) {
+            onUpstream(std::move(v), std::move(reqNext));
+        });
+    }
+    void request(std::size_t n) override
+    {
+        addDemand(this->demand, n);
+        Timed::upstreamToken().request(n);
+        Timed::drain();
+    }
+    void cancel() override
+    {
+        cancelTimers();
+        Timed::cancel();
+    }
+    void release() override
+    {
+        cancelTimers();
+        Timed::release();
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+
+  private:
+    void cancelTimers()
+    {
+        std::lock_guard guard(this->stateLock);
+        for (auto& t : timers)
+        {
+            t.cancel();
+        }
+        timers.clear();
+        delayed.clear();
+    }
+    void onUpstream(T&& v, CompletionToken&& reqNext)
+    {
+        std::lock_guard guard(this->stateLock);
+        this->upstream = reqNext;
+        delayed.push_back(std::move(v));
+        timers.push_back(
+            this->wheel.schedule(delay, this->executor, [this]() { due(); }));
+    }
+    void due()
+    {
+        {
+            std::lock_guard guard(this->stateLock);
+            if (delayed.empty())
+            {
+                return;
+            }
+            timers.pop_front();
+            this->ready.push_back(std::move(delayed.front()));
+            delayed.pop_front();
+        }
+        Timed::drain();
+    }
+};
+
+// Gives up on the upstream once it has gone quiet for longer than the
+// limit: the upstream is cancelled and beast::error::timeout goes down the
+// error channel, on the executor.
+// Demand passes straight through.
+template <typename T, typename ParentAdapter>
+struct Timeout : TimedStage<T, Timeout<T, ParentAdapter>>
+{
+    using Timed = TimedStage<T, Timeout<T, ParentAdapter>>;
+    using Clock = TimerWheel::Clock;
+    friend Timed;
+    ParentAdapter* src{nullptr};
+    TimerWheel::Duration limit;
+    Clock::time_point lastSignal;
+    bool finished{false};
+
+    Timeout(ParentAdapter* s, net::any_io_executor ex, TimerWheel::Duration d) :
+        Timed(std::move(ex)), src(s), limit(d)
+    {
+        rootAdaptee()->whenFinished([this]() {
+            std::lock_guard guard(this->stateLock);
+            finished = true;
+            this->timer.cancel();
+        });
+    }
+    Disposable subscribe(auto handler)
+    {
+        Timed::setSubscriber(std::move(handler));
+        Timed::start();
+        {
+            std::lock_guard guard(this->stateLock);
+            lastSignal = Clock::now();
+            finished = false;
+            Timed::rearm(limit);
+        }
+        Timed::listenForErrors(src);
+        return src->subscribe([this](T&& v, auto&& reqNext) {
+            {
+                std::lock_guard guard(this->stateLock);
+                lastSignal = Clock::now();
+                this->upstream = reqNext;
+                this->ready.push_back(std::move(v));
+            }
+            Timed::drain();
+        });
+    }
+    void request(std::size_t n) override
+    {
+        addDemand(this->demand, n);
+        Timed::upstreamToken().request(n);
+        Timed::drain();
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+
+  private:
+    void onTimer(std::unique_lock<std::mutex>& guard)
+    {
+        if (finished)
+        {
+            return;
+        }
+        auto idle = Clock::now() - lastSignal;
+        if (idle < limit)
+        {
+            Timed::rearm(limit - idle);
+            return;
+        }
+        this->cancelled = true;
+        auto up = this->upstream;
+        guard.unlock();
+        // Nothing may have arrived yet to carry an upstream token.
+        up.cancel();
+        rootAdaptee()->cancel();
+        Timed::error(beast::error::timeout, CompletionToken{});
+    }
+};
+
+// Emits the most recent upstream value once per period, if a new one came
+// in since the last tick. The upstream is consumed as fast as it produces;
+// a value still waiting for downstream demand is replaced by a newer one.
+// The last value is flushed when the flux finishes.
+template <typename T, typename ParentAdapter>
+struct Sample : TimedStage<T, Sample<T, ParentAdapter>>
+{
+    using Timed = TimedStage<T, Sample<T, ParentAdapter>>;
+    friend Timed;
+    ParentAdapter* src{nullptr};
+    TimerWheel::Duration period;
+    std::optional<T> latest;
+    bool finished{false};
+
+    Sample(ParentAdapter* s, net::any_io_executor ex, TimerWheel::Duration d) :
+        Timed(std::move(ex)), src(s), period(d)
+    {
+        rootAdaptee()->whenFinished([this]() {
+            {
+                std::lock_guard guard(this->stateLock);
+                finished = true;
+                this->timer.cancel();
+                publishLatest();
+            }
+            Timed::drain();
+        });
+    }
+    Disposable subscribe(auto handler)
+    {
+        Timed::setSubscriber(std::move(handler));
+        Timed::start();
+        {
+            std::lock_guard guard(this->stateLock);
+            finished = false;
+            Timed::rearm(period);
+        }
+        Timed::listenForErrors(src);
+        return src->subscribe([this](T&& v, auto&& reqNext) {
+            {
+                std::lock_guard guard(this->stateLock);
+                latest = std::move(v);
+                this->upstream = reqNext;
+            }
+            reqNext.request(1);
+        });
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+
+  private:
+    void publishLatest()
+    {
+        if (latest)
+        {
+            this->ready.clear();
+            this->ready.push_back(std::move(*latest));
+            latest.reset();
+        }
+    }
+    void onTimer(std::unique_lock<std::mutex>& guard)
+    {
+        if (finished)
+        {
+            return;
+        }
+        publishLatest();
+        Timed::rearm(period);
+        guard.unlock();
+        Timed::drain();
+    }
+};
+
+// Emits a value only once the upstream has been quiet for the given time
+// after it; values superseded within that window are dropped. The upstream
+// is consumed as fast as it produces, and a pending value is flushed when
+// the flux finishes.
+template <typename T, typename ParentAdapter>
+struct Debounce : TimedStage<T, Debounce<T, ParentAdapter>>
+{
+    using Timed = TimedStage<T, Debounce<T, ParentAdapter>>;
+    using Clock = TimerWheel::Clock;
+    friend Timed;
+    ParentAdapter* src{nullptr};
+    TimerWheel::Duration quiet;
+    std::optional<T> latest;
+    Clock::time_point lastArrival;
+    bool armed{false};
+
+    Debounce(ParentAdapter* s, net::any_io_executor ex,
+             TimerWheel::Duration d) :
+        Timed(std::move(ex)), src(s), quiet(d)
+    {
+        rootAdaptee()->whenFinished([this]() {
+            {
+                std::lock_guard guard(this->stateLock);
+                this->timer.cancel();
+                armed = false;
+                if (latest)
+                {
+                    this->ready.push_back(std::move(*latest));
+                    latest.reset();
+                }
+            }
+            Timed::drain();
+        });
+    }
+    Disposable subscribe(auto handler)
+    {
+        Timed::setSubscriber(std::move(handler));
+        Timed::start();
+        Timed::listenForErrors(src);
+        return src->subscribe([this](T&& v, auto&& reqNext) {
+            {
+                std::lock_guard guard(this->stateLock);
+                latest = std::move(v);
+                lastArrival = Clock::now();
+                this->upstream = reqNext;
+                if (!std::exchange(armed, true))
+                {
+                    Timed::rearm(quiet);
+                }
+            }
+            reqNext.request(1);
+        });
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+
+  private:
+    // One timer per quiet window rather than one per value: a tick that
+    // comes too early moves itself to the end of the current window.
+    void onTimer(std::unique_lock<std::mutex>& guard)
+    {
+        armed = false;
+        if (!latest)
+        {
+            return;
+        }
+        auto idle = Clock::now() - lastArrival;
+        if (idle < quiet)
+        {
+            armed = true;
+            Timed::rearm(quiet - idle);
+            return;
+        }
+        this->ready.push_back(std::move(*latest));
+        latest.reset();
+        guard.unlock();
+        Timed::drain();
+    }
+};
+
+// Collects values into batches of up to maxSize, emitting a batch when it
+// is full or maxWait after its first value arrived, whichever comes first.
+// A partial batch is flushed when the flux finishes. The upstream is paused
+// while a batch waits for downstream demand.
+template <typename T, typename ParentAdapter>
+struct BufferTimeout :
+    TimedStage<std::vector<T>, BufferTimeout<T, ParentAdapter>>
+{
+    using Timed = TimedStage<std::vector<T>, BufferTimeout<T, ParentAdapter>>;
+    friend Timed;
+    ParentAdapter* src{nullptr};
+    std::size_t maxSize;
+    TimerWheel::Duration maxWait;
+    std::vector<T> buffer;
+    bool paused{false};
+
+    BufferTimeout(ParentAdapter* s, net::any_io_executor ex, std::size_t n,
+                  TimerWheel::Duration d) :
+        Timed(std::move(ex)), src(s), maxSize(std::max<std::size_t>(n, 1)),
+        maxWait(d)
+    {
+        rootAdaptee()->whenFinished([this]() {
+            {
+                std::lock_guard guard(this->stateLock);
+                flush();
+            }
+            Timed::drain();
+        });
+    }
+    Disposable subscribe(auto handler)
+    {
+        Timed::setSubscriber(std::move(handler));
+        Timed::start();
+        Timed::listenForErrors(src);
+        return src->subscribe([this](T&& v, auto&& reqNext) {
+            onUpstream(std::move(v), std::move(reqNext));
+        });
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+
+  private:
+    void onUpstream(T&& v, CompletionToken&& reqNext)
+    {
+        {
+            std::lock_guard guard(this->stateLock);
+            this->upstream = reqNext;
+            if (buffer.empty())
+            {
+                buffer.reserve(maxSize);
+                Timed::rearm(maxWait);
+            }
+            buffer.push_back(std::move(v));
+            if (buffer.size() >= maxSize)
+            {
+                flush();
+            }
+        }
+        Timed::drain();
+        std::unique_lock guard(this->stateLock);
+        if (!this->ready.empty())
+        {
+            paused = true;
+            return;
+        }
+        guard.unlock();
+        reqNext.request(1);
+    }
+    // Call with stateLock held.
+    void flush()
+    {
+        this->timer.cancel();
+        if (!buffer.empty())
+        {
+            this->ready.push_back(std::move(buffer));
+            buffer = {};
+        }
+    }
+    void onTimer(std::unique_lock<std::mutex>& guard)
+    {
+        flush();
+        guard.unlock();
+        Timed::drain();
+    }
+    void delivered()
+    {
+        std::unique_lock guard(this->stateLock);
+        if (!paused || !this->ready.empty())
+        {
+            return;
+        }
+        paused = false;
+        auto up = this->upstream;
+        guard.unlock();
+        up.request(1);
+    }
+};
+
+template <typename T>
+struct FluxBase : SubscriberType<T, FluxBase<T>>, Subscription
+{
+    using value_type = T;
+    using Base = SubscriberType<T, FluxBase<T>>;
+
+    struct SourceHandler
+    {
+        virtual void next(std::function<void(T)> consumer) = 0;
+        virtual bool hasNext() const = 0;
+        // The subscriber will not ask for more.
+        virtual void cancel() {}
+        virtual ~SourceHandler() {}
+        // For async sources that only learn after next() that no value is
+        // coming: report it here instead of calling the consumer, once
+        // hasNext() has turned false.
+        std::function<void()> completionHandler;
+        void complete()
+        {
+            if (completionHandler)
+            {
+                completionHandler();
+            }
+        }
+        // Reports a failed next() instead of calling the consumer. The
+        // error goes down the error channel; a retry calls next() again.
+        std::function<void(const beast::error_code&)> errorHandler;
+        void fail(const beast::error_code& ec)
+        {
+            if (errorHandler)
+            {
+                errorHandler(ec);
+            }
+        }
+    };
+
+  protected:
+    explicit FluxBase(SourceHandler* srcHandler) : mSource(srcHandler) {}
+    std::unique_ptr<SourceHandler> mSource{};
+    std::function<void()> onFinishHandler{};
+    std::function<void(const beast::error_code&)> onErrorHandler{};
+    std::vector<std::function<void()>> finishObservers;
+    std::unique_ptr<PipelineArena> mArena;
+    // Requests may arrive from whichever thread the downstream runs on once
+    // schedulers are involved, so the demand is atomic and a work-in-progress
+    // count elects the one thread that pulls from the source. Moving a root
+    // never carries an active subscription along; the state starts afresh.
+    struct DemandState
+    {
+        std::atomic<std::size_t> demand{0};
+        WorkInProgress wip;
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> completed{false};
+        std::atomic<bool> awaitingValue{false};
+        // Deliveries on the stack, and a dispose() that waits for them.
+        std::atomic<std::size_t> delivering{0};
+        std::atomic<bool> disposePending{false};
+        // Values operators still have to hand downstream, and a completion
+        // that waits for them; see holdFinish().
+        std::atomic<std::size_t> finishHolds{0};
+        std::atomic<bool> finishPending{false};
+        DemandState() = default;
+        DemandState(const DemandState&) {}
+        DemandState& operator=(const DemandState&)
+        {
+            return *this;
+        }
+    };
+    DemandState state;
+    // State of pull-style consumption through asyncNext().
+    struct PullState
+    {
+        std::mutex lock;
+        std::function<void(std::optional<T>)> waiter;
+        CompletionToken token;
+        bool subscribed{false};
+        bool finished{false};
+    };
+    std::unique_ptr<PullState> mPull;
+    SourceHandler* source() const
+    {
+        return mSource.get();
+    }
+    // Pulls from the source while there is outstanding demand. A request
+    // made while a value is being delivered (always the case for sync
+    // sources) only raises the demand the running loop picks up, so the
+    // stack stays flat no matter how many elements flow. Async sources
+    // return from next() before the value arrives; the loop then stops
+    // until the value shows up, as at most one next() may be outstanding.
+    void drain()
+    {
+        std::shared_ptr<SubscriberBase> keepAlive;
+        state.wip.drain([this, &keepAlive]() {
+            while (!state.cancelled && !state.completed &&
+                   !state.awaitingValue && state.demand > 0)
+            {
+                if (!mSource->hasNext())
+                {
+                    state.completed = true;
+                    // A finish observer may drop the last reference to
+                    // this flux; keep it alive until the loop unwinds.
+                    keepAlive = Base::weak_from_this().lock();
+                    complete();
+                    break;
+                }
+                --state.demand;
+                state.awaitingValue = true;
+                mSource->next([this](T&& v) { onNextValue(std::move(v)); });
+            }
+        });
+    }
+    void onNextValue(T&& v)
+    {
+        // The subscriber may request more from inside visit, which can
+        // finish this flux and drop the owner's last reference to it.
+        if (state.cancelled)
+        {
+            return;
+        }
+        auto keepAlive = Base::weak_from_this().lock();
+        state.awaitingValue = false;
+        ++state.delivering;
+        Base::visit(std::move(v), CompletionToken(this));
+        delivered();
+        drain();
+    }
+    // The source is done. Finishes now, or once the last hold is released.
+    void complete()
+    {
+        state.finishPending = true;
+        if (state.finishHolds == 0 && state.finishPending.exchange(false))
+        {
+            finish({});
+        }
+    }
+    // Finish observers run either way, so stages flush and stop their
+    // timers; then onFinish, or onError if the flux failed.
+    void finish(const beast::error_code& ec)
+    {
+        ++state.delivering;
+        for (auto& observer : finishObservers)
+        {
+            observer();
+        }
+        if (ec && onErrorHandler)
+        {
+            onErrorHandler(ec);
+        }
+        else if (!ec && onFinishHandler)
+        {
+            onFinishHandler();
+        }
+        delivered();
+    }
+    void delivered()
+    {
+        if (--state.delivering == 0 && state.disposePending.exchange(false))
+        {
+            releaseHandlers();
+        }
+    }
+    // Breaks the cycles handlers tend to form with the flux that owns them
+    // (a handler holding a shared_ptr to its own root), so a disposed
+    // pipeline goes away with its last outside reference.
+    void releaseHandlers()
+    {
+        Base::release();
+        onFinishHandler = nullptr;
+        onErrorHandler = nullptr;
+        finishObservers.clear();
+        if (mArena)
+        {
+            mArena->release();
+        }
+    }
+    // The demand spent on the value that never came goes back, so the
+    // drain loop gets to see hasNext() turn false and finish.
+    void onSourceComplete()
+    {
+        ++state.demand;
+        state.awaitingValue = false;
+        drain();
+    }
+    // The failed next() is over; a request through the token retries it.
+    void onSourceError(const beast::error_code& ec)
+    {
+        if (state.cancelled)
+        {
+            return;
+        }
+        auto keepAlive = Base::weak_from_this().lock();
+        state.awaitingValue = false;
+        Base::error(ec, CompletionToken(this));
+        drain();
+    }
+
+  public:
+    Disposable subscribe(auto handler)
+    {
+        Base::setSubscriber(std::move(handler));
+        state.demand = 0;
+        state.cancelled = false;
+        state.completed = false;
+        state.finishHolds = 0;
+        state.finishPending = false;
+        if (mSource)
+        {
+            mSource->completionHandler = [this]() { onSourceComplete(); };
+            mSource->errorHandler = [this](const beast::error_code& ec) {
+                onSourceError(ec);
+            };
+        }
+        request(1);
+        return Disposable(this);
+    }
+    void request(std::size_t n) override
+    {
+        addDemand(state.demand, n);
+        drain();
+    }
+    void cancel() override
+    {
+        if (!state.cancelled.exchange(true) && mSource)
+        {
+            mSource->cancel();
+        }
+    }
+    // Cancels the source and drops every handler in the pipeline. Called
+    // from inside a handler, the handlers go once the delivery unwinds.
+    // Stage objects stay in the arena until the root is destroyed, as
+    // work already posted by async stages may still refer to them.
+    void dispose() override
+    {
+        cancel();
+        state.disposePending = true;
+        if (state.delivering == 0 && state.disposePending.exchange(false))
+        {
+            releaseHandlers();
+        }
+    }
+    FluxBase& onFinish(std::function<void()> finish)
+    {
+        onFinishHandler = std::move(finish);
+        return *this;
+    }
+    // Where an error ends up when no operator downstream handles it. The
+    // flux is cancelled and finishes with onError instead of onFinish.
+    FluxBase& onError(std::function<void(const beast::error_code&)> handler)
+    {
+        onErrorHandler = std::move(handler);
+        return *this;
+    }
+    // Ends the flux from a stage: completes it, or fails it with ec. Only
+    // the first call counts.
+    void terminate(const beast::error_code& ec = {})
+    {
+        if (state.completed.exchange(true))
+        {
+            return;
+        }
+        auto keepAlive = Base::weak_from_this().lock();
+        cancel();
+        finish(ec);
+    }
+    // Completion hook for operators, so they do not take over onFinish.
+    // Observers run before the onFinish handler, letting stages flush what
+    // they still hold.
+    void whenFinished(std::function<void()> observer)
+    {
+        finishObservers.push_back(std::move(observer));
+    }
+    // For operators that hand values on after the source is done, from a
+    // queue or another thread: a hold taken per value keeps the flux from
+    // finishing until it is released, so completion follows the last value.
+    // A failed or terminated flux does not wait.
+    void holdFinish()
+    {
+        ++state.finishHolds;
+    }
+    // Releases n holds. The last one may finish the flux, which can drop
+    // the last reference to the pipeline; touch no stage after calling it.
+    void releaseFinish(std::size_t n = 1)
+    {
+        if (n == 0 || state.finishHolds.fetch_sub(n) != n ||
+            !state.finishPending.exchange(false))
+        {
+            return;
+        }
+        auto keepAlive = Base::weak_from_this().lock();
+        finish({});
+    }
+    // Asks for one value and completes with it, or with nullopt once the
+    // flux is finished. Works with any asio completion token, so a
+    // coroutine can loop with
+    //     while (auto v = co_await flux.asyncNext(net::use_awaitable))
+    // and only pulls as fast as it consumes. Completions are posted to the
+    // handler's associated executor.
+    template <typename Token>
+    auto asyncNext(Token&& token)
+    {
+        return net::async_initiate<Token, void(std::optional<T>)>(
+            [this](auto handler) {
+            using Handler = decltype(handler);
+            auto executor = net::get_associated_executor(handler);
+            struct Waiter
+            {
+                Handler handler;
+                net::executor_work_guard<decltype(executor)> work;
+            };
+            auto waiter = std::make_shared<Waiter>(
+                Waiter{std::move(handler), net::make_work_guard(executor)});
+            waitNext([waiter](std::optional<T> v) {
+                auto ex = waiter->work.get_executor();
+                net::post(ex, [waiter, v = std::move(v)]() mutable {
+                    waiter->work.reset();
+                    std::move(waiter->handler)(std::move(v));
+                });
+            });
+        },
+            token);
+    }
+    // The spelling for monos (Mono, HttpMono): completes with the value, or
+    // nullopt if the mono finished empty.
+    template <typename Token>
+    auto asyncGet(Token&& token)
+    {
+        return asyncNext(std::forward<Token>(token));
+    }
+
+    auto rootAdaptee()
+    {
+        return this;
+    }
+    template <typename Stage, typename... Args>
+    Stage& makeStage(Args&&... args)
+    {
+        if (!mArena)
+        {
+            mArena = std::make_unique<PipelineArena>();
+        }
+        return mArena->make<Stage>(std::forward<Args>(args)...);
+    }
+    ArenaStats arenaStats() const
+    {
+        return mArena ? mArena->stats() : ArenaStats{};
+    }
+    auto getSharedPtr()
+    {
+        return Base::shared_from_this();
+    }
+
+  private:
+    PullState& pullState()
+    {
+        if (!mPull)
+        {
+            mPull = std::make_unique<PullState>();
+        }
+        return *mPull;
+    }
+    void waitNext(std::function<void(std::optional<T>)> waiter)
+    {
+        auto& pull = pullState();
+        std::unique_lock lock(pull.lock);
+        if (pull.finished)
+        {
+            lock.unlock();
+            waiter(std::nullopt);
+            return;
+        }
+        pull.waiter = std::move(waiter);
+        if (pull.subscribed)
+        {
+            auto token = pull.token;
+            lock.unlock();
+            token.request(1);
+            return;
+        }
+        pull.subscribed = true;
+        lock.unlock();
+        whenFinished([&pull]() {
+            std::unique_lock lock(pull.lock);
+            pull.finished = true;
+            auto waiter = std::exchange(pull.waiter, nullptr);
+            lock.unlock();
+            if (waiter)
+            {
+                waiter(std::nullopt);
+            }
+        });
+        subscribe([&pull](T&& v, auto&& reqNext) {
+            std::unique_lock lock(pull.lock);
+            pull.token = reqNext;
+            auto waiter = std::exchange(pull.waiter, nullptr);
+            lock.unlock();
+            waiter(std::move(v));
+        });
+    }
+};
+template <typename T>
+struct Mono : FluxBase<T>
+{
+    using Base = FluxBase<T>;
+    struct Just : Base::SourceHandler
+    {
+        T value{};
+        bool mHasNext{true};
+        explicit Just(T v) : value(std::move(v)) {}
+        void next(std::function<void(T)> consumer) override
+        {
+            mHasNext = false;
+            consumer(std::move(value));
+        }
+        bool hasNext() const override
+        {
+            return mHasNext;
+        }
+    };
+
+    explicit Mono(Base::SourceHandler* srcHandler) : Base(srcHandler) {}
+    Mono() : Base(nullptr) {}
+    static Mono just(T v)
+    {
+        return Mono{new Just(std::move(v))};
+    }
+    static std::shared_ptr<Mono> justPtr(T v)
+    {
+        return std::make_shared<Mono>(new Just(std::move(v)));
+    }
+    struct Generator : Base::SourceHandler
+    {
+        using GeneratorFunc = std::function<T()>;
+        GeneratorFunc generator;
+        bool mHasNext{true};
+        explicit Generator(GeneratorFunc f) : generator(std::move(f)) {}
+        void next(std::function<void(T)> consumer) override
+        {
+            mHasNext = false;
+            consumer(generator());
+        }
+        bool hasNext() const override
+        {
+            return mHasNext;
+        }
+    };
+    static Mono justFrom(Generator::GeneratorFunc f)
+    {
+        return Mono{new Generator(std::move(f))};
+    }
+    static std::shared_ptr<Mono> justPtr(Generator::GeneratorFunc f)
+    {
+        return std::make_shared<Mono>(new Generator(std::move(f)));
+    }
+    // Memoizes the monos factory() returns (a Mono or a shared_ptr to one,
+    // like WebClient::toMono()); see MonoCache.
+    template <typename Factory>
+    static std::shared_ptr<MonoCache<T>>
+        cache(Factory factory, TimerWheel::Duration ttl,
+              TimerWheel::Duration refreshAhead = {})
+    {
+        using Inner = InnerPublisher<std::invoke_result_t<Factory&>>;
+        return std::make_shared<MonoCache<T>>(
+            [factory = std::move(factory)]() mutable
+            -> std::shared_ptr<FluxBase<T>> {
+            return Inner::share(factory());
+        },
+            ttl, refreshAhead);
+    }
+};
+
+template <typename T>
+struct Flux : FluxBase<T>
+{
+    using Base = FluxBase<T>;
+    template <class R>
+    struct Range : Base::SourceHandler
+    {
+        R range{};
+        R::iterator current{};
+        explicit Range(R v) : range(std::move(v)), current(range.begin()) {}
+        void next(std::function<void(T)> consumer) override
+        {
+            T v = std::move(*current);
+            ++current;
+            consumer(std::move(v));
+        }
+        bool hasNext() const override
+        {
+            return current != range.end();
+        }
+    };
+
+    explicit Flux(Base::SourceHandler* srcHandler) : Base(srcHandler) {}
+    Flux() : Base(nullptr) {}
+    template <class R>
+    static Flux range(R v)
+    {
+        return Flux{new Range<R>(std::move(v))};
+    }
+
+    // Counts up from zero, one value per period on the executor. Periods
+    // are measured from the start, so a consumer that is slow now and then
+    // does not make the rest drift; one that keeps falling behind gets the
+    // values back to back.
+    struct Interval : Base::SourceHandler
+    {
+        net::any_io_executor executor;
+        TimerWheel::Duration period;
+        TimerWheel::Clock::time_point start{};
+        std::size_t count{0};
+        TimerWheel::Handle timer;
+        Interval(net::any_io_executor ex, TimerWheel::Duration p) :
+            executor(std::move(ex)), period(p)
+        {}
+        ~Interval()
+        {
+            timer.cancel();
+        }
+        void next(std::function<void(T)> consumer) override
+        {
+            auto now = TimerWheel::Clock::now();
+            if (count == 0)
+            {
+                start = now;
+            }
+            auto due = start + period * (count + 1);
+            timer = TimerWheel::of(executor).schedule(
+                due - now, executor,
+                [this, consumer = std::move(consumer)]() {
+                consumer(T(count++));
+            });
+        }
+        bool hasNext() const override
+        {
+            return true;
+        }
+        void cancel() override
+        {
+            timer.cancel();
+        }
+    };
+    static Flux interval(net::any_io_executor executor,
+                         TimerWheel::Duration period)
+        requires std::constructible_from<T, std::size_t>
+    {
+        return Flux{new Interval(std::move(executor), period)};
+    }
+
+    struct Generator : Base::SourceHandler
+    {
+        using GeneratorFunc = std::function<T(bool& next)>;
+        GeneratorFunc generator;
+        bool nextFound{true};
+        explicit Generator(GeneratorFunc f) : generator(std::move(f)) {}
+        void next(std::function<void(T)> consumer) override
+        {
+            consumer(generator(nextFound));
+        }
+        bool hasNext() const override
+        {
+            return nextFound;
+        }
+        void cancel() override
+        {
+            nextFound = false;
+        }
+    };
+
+    static Flux generate(Generator::GeneratorFunc f)
+    {
+        return Flux{new Generator(std::move(f))};
+    }
+};
+
+// Open-addressing map from key to group, probed linearly. Slots keep the
+// hash next to the pointer, so a probe rarely has to look at a group, and
+// erase shifts the rest of the run back instead of leaving tombstones. The
+// table never grows: it is sized for its cap at half load. Hashes are mixed
+// before use; std::hash of an integer is the integer itself, and runs of
+// consecutive keys would otherwise pile up into one long cluster.
+template <typename K, typename G>
+class GroupTable
+{
+    struct Slot
+    {
+        std::size_t hash{0};
+        G* group{nullptr};
+    };
+    std::vector<Slot> slots;
+    std::size_t mask;
+    std::size_t count{0};
+
+    std::size_t home(std::size_t hash) const
+    {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        return hash & mask;
+    }
+
+  public:
+    explicit GroupTable(std::size_t cap) :
+        slots(std::bit_ceil(std::max<std::size_t>(cap * 2, 8))),
+        mask(slots.size() - 1)
+    {}
+    G* find(std::size_t hash, const K& key) const
+    {
+        for (auto i = home(hash);; i = (i + 1) & mask)
+        {
+            const auto& slot = slots[i];
+            if (slot.group == nullptr)
+            {
+                return nullptr;
+            }
+            if (slot.hash == hash && slot.group->key == key)
+            {
+                return slot.group;
+            }
+        }
+    }
+    // The key must not be in the table yet.
+    void insert(std::size_t hash, G* group)
+    {
+        auto i = home(hash);
+        while (slots[i].group != nullptr)
+        {
+            i = (i + 1) & mask;
+        }
+        slots[i] = Slot{hash, group};
+        ++count;
+    }
+    void erase(std::size_t hash, const G* group)
+    {
+        auto hole = home(hash);
+        while (slots[hole].group != group)
+        {
+            hole = (hole + 1) & mask;
+        }
+        // Pull back every entry after the hole that may sit in it, i.e.
+        // whose home slot is not between the hole and where it is now.
+        for (auto i = (hole + 1) & mask; slots[i].group != nullptr;
+             i = (i + 1) & mask)
+        {
+            auto start = home(slots[i].hash);
+            if (((i - start) & mask) >= ((i - hole) & mask))
+            {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+        slots[hole] = Slot{};
+        --count;
+    }
+    void clear()
+    {
+        std::fill(slots.begin(), slots.end(), Slot{});
+        count = 0;
+    }
+    std::size_t size() const
+    {
+        return count;
+    }
+};
+
+// A group handed out by groupBy(): the values that share one key.
+template <typename K, typename T>
+struct GroupedFlux : Flux<T>
+{
+    using Base = Flux<T>;
+    K groupKey;
+    GroupedFlux(Base::SourceHandler* srcHandler, K k) :
+        Base(srcHandler), groupKey(std::move(k))
+    {}
+    const K& key() const
+    {
+        return groupKey;
+    }
+};
+
+template <typename T, typename KeyFn>
+using GroupKeyOf = std::decay_t<std::invoke_result_t<KeyFn&, const T&>>;
+
+// Splits the upstream into one GroupedFlux per key. A group goes downstream
+// with its first value, without waiting for demand; subscribe to every
+// group, as the upstream is held back once a group has `prefetch` values
+// queued. Cancelling a group drops what comes for it. Live groups sit in a
+// GroupTable and a least-recently-used list. Groups idle for idleTimeout
+// are completed; so is the least recently used one when a new key finds the
+// table full, unless it still has values queued, in which case the flux
+// fails with no_buffer_space. The idle timeout runs on the wheel of the
+// timer executor, so groups also go idle while the upstream is quiet. A
+// later value for a completed key opens a new group. Groups pinned to an
+// executor deliver there, so groups run in parallel while each keeps its
+// order. All groups complete with the upstream.
+template <typename T, typename ParentAdapter, typename KeyFn>
+struct GroupBy :
+    SubscriberType<std::shared_ptr<GroupedFlux<GroupKeyOf<T, KeyFn>, T>>,
+                   GroupBy<T, ParentAdapter, KeyFn>>,
+    ArenaStage
+{
+    using Key = GroupKeyOf<T, KeyFn>;
+    using Grouped = GroupedFlux<Key, T>;
+    using Base = SubscriberType<std::shared_ptr<Grouped>,
+                                GroupBy<T, ParentAdapter, KeyFn>>;
+    using Clock = TimerWheel::Clock;
+
+    // The source of one group's flux.
+    struct Group : FluxBase<T>::SourceHandler
+    {
+        Key key;
+        std::size_t hash;
+        std::size_t prefetch;
+        std::optional<net::any_io_executor> executor;
+        mutable std::mutex lock;
+        std::deque<T> queue;
+        std::function<void(T)> waiting;
+        // The upstream, while this group is full.
+        CompletionToken held;
+        bool done{false};
+        bool discarding{false};
+        std::weak_ptr<Grouped> owner;
+        // Owned by the table while the group is live.
+        std::shared_ptr<Grouped> live;
+        Clock::time_point lastSeen{};
+        Group* newer{nullptr};
+        Group* older{nullptr};
+        static inline thread_local const Group* draining{nullptr};
+
+        Group(Key k, std::size_t h, std::size_t pf,
+              std::optional<net::any_io_executor> ex) :
+            key(std::move(k)), hash(h), prefetch(pf), executor(std::move(ex))
+        {}
+        void next(std::function<void(T)> consumer) override
+        {
+            std::unique_lock guard(lock);
+            if (!queue.empty() && (!executor || draining == this))
+            {
+                deliver(guard, std::move(consumer));
+                return;
+            }
+            if (queue.empty() && done)
+            {
+                guard.unlock();
+                this->complete();
+                return;
+            }
+            waiting = std::move(consumer);
+            if (!queue.empty())
+            {
+                guard.unlock();
+                schedule();
+            }
+        }
+        bool hasNext() const override
+        {
+            std::lock_guard guard(lock);
+            return !done || !queue.empty();
+        }
+        void cancel() override
+        {
+            std::unique_lock guard(lock);
+            discarding = true;
+            queue.clear();
+            auto up = std::exchange(held, CompletionToken{});
+            guard.unlock();
+            up.request(1);
+        }
+        // Queues a value; false holds the upstream back.
+        bool push(T&& v, const CompletionToken& upstream)
+        {
+            std::unique_lock guard(lock);
+            if (discarding || done)
+            {
+                return true;
+            }
+            queue.push_back(std::move(v));
+            bool full = queue.size() >= prefetch;
+            if (full)
+            {
+                held = upstream;
+            }
+            bool wake = static_cast<bool>(waiting);
+            guard.unlock();
+            if (wake)
+            {
+                schedule();
+            }
+            return !full;
+        }
+        void finish()
+        {
+            std::unique_lock guard(lock);
+            done = true;
+            bool wake = waiting && queue.empty();
+            guard.unlock();
+            if (wake)
+            {
+                schedule();
+            }
+        }
+        bool idle() const
+        {
+            std::lock_guard guard(lock);
+            return queue.empty();
+        }
+
+      private:
+        void schedule()
+        {
+            auto flux = owner.lock();
+            if (!flux)
+            {
+                return;
+            }
+            if (!executor)
+            {
+                resume();
+                return;
+            }
+            net::post(*executor,
+                      [this, flux = std::move(flux)]() { resume(); });
+        }
+        void resume()
+        {
+            std::unique_lock guard(lock);
+            if (!waiting)
+            {
+                return;
+            }
+            if (queue.empty())
+            {
+                if (done)
+                {
+                    waiting = nullptr;
+                    guard.unlock();
+                    this->complete();
+                }
+                return;
+            }
+            auto consumer = std::exchange(waiting, nullptr);
+            draining = this;
+            deliver(guard, std::move(consumer));
+            draining = nullptr;
+        }
+        void deliver(std::unique_lock<std::mutex>& guard,
+                     std::function<void(T)> consumer)
+        {
+            T v = std::move(queue.front());
+            queue.pop_front();
+            auto up = queue.size() < prefetch
+                          ? std::exchange(held, CompletionToken{})
+                          : CompletionToken{};
+            guard.unlock();
+            consumer(std::move(v));
+            up.request(1);
+        }
+    };
+    using Closed = std::vector<std::pair<Group*, std::shared_ptr<Grouped>>>;
+
+    ParentAdapter* src{nullptr};
+    KeyFn keyFn;
+    GroupByOptions options;
+    std::mutex lock;
+    GroupTable<Key, Group> table;
+    Group* newest{nullptr};
+    Group* oldest{nullptr};
+    TimerWheel* wheel{nullptr};
+    // Wakes up when the oldest group would go idle.
+    TimerWheel::Handle sweep;
+    bool sweepArmed{false};
+
+    GroupBy(ParentAdapter* s, KeyFn fn, GroupByOptions opts) :
+        src(s), keyFn(std::move(fn)), options(std::move(opts)),
+        table(std::max<std::size_t>(options.maxGroups, 1))
+    {
+        options.maxGroups = std::max<std::size_t>(options.maxGroups, 1);
+        options.prefetch = std::max<std::size_t>(options.prefetch, 1);
+        if (!options.timerExecutor && !options.executors.empty())
+        {
+            options.timerExecutor = options.executors.front();
+        }
+        if (options.timerExecutor &&
+            options.idleTimeout > TimerWheel::Duration::zero())
+        {
+            wheel = &TimerWheel::of(options.timerExecutor);
+        }
+        rootAdaptee()->whenFinished([this]() { closeAll(); });
+    }
+    // Groups still live when the pipeline goes away are only let go of.
+    ~GroupBy()
+    {
+        sweep.cancel();
+        for (auto* group = newest; group != nullptr;)
+        {
+            auto* older = group->older;
+            group->live.reset();
+            group = older;
+        }
+    }
+    Disposable subscribe(auto handler)
+    {
+        Base::setSubscriber(std::move(handler));
+        Base::listenForErrors(src);
+        return src->subscribe([this](T&& v, auto&& reqNext) {
+            route(std::move(v), std::move(reqNext));
+        });
+    }
+    void release() override
+    {
+        Base::release();
+        closeAll();
+    }
+    auto rootAdaptee()
+    {
+        return src->rootAdaptee();
+    }
+
+  private:
+    void route(T&& v, CompletionToken&& reqNext)
+    {
+        Key key = keyFn(std::as_const(v));
+        auto hash = std::hash<Key>{}(key);
+        std::shared_ptr<Grouped> opened;
+        Closed closed;
+        Group* group = nullptr;
+        {
+            std::lock_guard guard(lock);
+            auto now = options.idleTimeout > TimerWheel::Duration::zero()
+                           ? Clock::now()
+                           : Clock::time_point{};
+            while (oldest != nullptr && now != Clock::time_point{} &&
+                   now - oldest->lastSeen >= options.idleTimeout &&
+                   oldest->idle())
+            {
+                evict(oldest, closed);
+            }
+            group = table.find(hash, key);
+            if (group == nullptr && table.size() >= options.maxGroups &&
+                oldest->idle())
+            {
+                evict(oldest, closed);
+            }
+            if (group == nullptr && table.size() < options.maxGroups)
+            {
+                group = open(std::move(key), hash);
+                opened = group->live;
+            }
+            if (group != nullptr)
+            {
+                group->lastSeen = now;
+                touch(group);
+                armSweep(now);
+            }
+        }
+        finishAll(closed);
+        if (group == nullptr)
+        {
+            Base::error(net::error::no_buffer_space, std::move(reqNext));
+            return;
+        }
+        if (opened)
+        {
+            Base::visit(std::move(opened), CompletionToken{});
+        }
+        if (group->push(std::move(v), reqNext))
+        {
+            reqNext.request(1);
+        }
+    }
+    Group* open(Key key, std::size_t hash)
+    {
+        std::optional<net::any_io_executor> executor;
+        if (!options.executors.empty())
+        {
+            executor = options.executors[hash % options.executors.size()];
+        }
+        auto* group =
+            new Group(key, hash, options.prefetch, std::move(executor));
+        auto flux = std::make_shared<Grouped>(group, std::move(key));
+        group->owner = flux;
+        group->live = std::move(flux);
+        table.insert(hash, group);
+        return group;
+    }
+    // Most recently used at the front.
+    void touch(Group* group)
+    {
+        if (newest == group)
+        {
+            return;
+        }
+        unlink(group);
+        group->newer = nullptr;
+        group->older = newest;
+        if (newest != nullptr)
+        {
+            newest->newer = group;
+        }
+        newest = group;
+        if (oldest == nullptr)
+        {
+            oldest = group;
+        }
+    }
+    void unlink(Group* group)
+    {
+        if (group->newer != nullptr)
+        {
+            group->newer->older = group->older;
+        }
+        else if (newest == group)
+        {
+            newest = group->older;
+        }
+        if (group->older != nullptr)
+        {
+            group->older->newer = group->newer;
+        }
+        else if (oldest == group)
+        {
+            oldest = group->newer;
+        }
+        group->newer = group->older = nullptr;
+    }
+    // Call with lock held.
+    void armSweep(Clock::time_point now)
+    {
+        if (wheel == nullptr || oldest == nullptr || sweepArmed)
         {
-            mSource->next([this](const T& v) { Base::visit(v); });
             return;
         }
-        if (onFinishHandler)
+        auto due = oldest->lastSeen + options.idleTimeout;
+        // A group that is still busy gets another full timeout.
+        auto delay = due > now ? due - now : options.idleTimeout;
+        sweepArmed = true;
+        sweep = wheel->schedule(delay, options.timerExecutor,
+                                [this]() { onSweep(); });
+    }
+    void onSweep()
+    {
+        Closed closed;
         {
-            onFinishHandler();
+            std::lock_guard guard(lock);
+            sweepArmed = false;
+            auto now = Clock::now();
+            while (oldest != nullptr &&
+                   now - oldest->lastSeen >= options.idleTimeout &&
+                   oldest->idle())
+            {
+                evict(oldest, closed);
+            }
+            armSweep(now);
         }
+        finishAll(closed);
     }
-    FluxBase& onFinish(std::function<void()> finish)
+    void evict(Group* group, Closed& closed)
     {
-        onFinishHandler = std::move(finish);
+        table.erase(group->hash, group);
+        unlink(group);
+        closed.emplace_back(group, std::move(group->live));
+    }
+    void closeAll()
+    {
+        Closed closed;
+        {
+            std::lock_guard guard(lock);
+            for (auto* group = newest; group != nullptr; group = group->older)
+            {
+                closed.emplace_back(group, std::move(group->live));
+            }
+            newest = oldest = nullptr;
+            table.clear();
+            sweep.cancel();
+            sweepArmed = false;
+        }
+        finishAll(closed);
+    }
+    // Outside the lock: finishing a group may complete its flux inline.
+    static void finishAll(Closed& closed)
+    {
+        for (auto& [group, flux] : closed)
+        {
+            group->finish();
+        }
+    }
+};
+
+// Shares one subscription to an upstream between any number of
+// subscribers, each of which gets its own Flux from asFlux(). Values land
+// in a ring with a cursor per subscriber. The upstream is only asked for
+// more while the slowest subscriber leaves room in the ring, so a slow
+// consumer holds the others back instead of losing values. The last
+// `history` values stay in the ring for late subscribers (replay, cache);
+// without history a subscriber sees what arrives after it joined. Every
+// subscriber gets its own copy of a value. A connectable hub subscribes
+// upstream on connect(), an auto-connecting one as soon as the first
+// subscriber asks for a value. The hub keeps a shared upstream root alive.
+template <typename T>
+class Multicast : public std::enable_shared_from_this<Multicast<T>>
+{
+    using Consumer = std::function<void(T)>;
+    struct Cursor
+    {
+        std::size_t next{0};
+        Consumer waiting;
+        typename FluxBase<T>::SourceHandler* source{nullptr};
+    };
+    struct Source : FluxBase<T>::SourceHandler
+    {
+        std::shared_ptr<Multicast> hub;
+        std::shared_ptr<Cursor> cursor;
+        Source(std::shared_ptr<Multicast> h, std::shared_ptr<Cursor> c) :
+            hub(std::move(h)), cursor(std::move(c))
+        {}
+        ~Source() override
+        {
+            hub->leave(cursor);
+        }
+        void next(Consumer consumer) override
+        {
+            hub->pull(this, cursor, std::move(consumer));
+        }
+        bool hasNext() const override
+        {
+            return hub->hasNext(*cursor);
+        }
+        void cancel() override
+        {
+            hub->leave(cursor);
+        }
+    };
+
+    std::mutex lock;
+    boost::circular_buffer<T> ring;
+    std::size_t base{0};
+    std::size_t history;
+    std::vector<std::shared_ptr<Cursor>> cursors;
+    std::function<void()> connector;
+    std::shared_ptr<SubscriberBase> upstreamOwner;
+    CompletionToken upstream;
+    bool autoConnect;
+    bool connected{false};
+    bool completed{false};
+    bool paused{false};
+
+  public:
+    Multicast(std::size_t keep, std::size_t capacity, bool autoConnecting) :
+        ring(std::max({keep, capacity, std::size_t{1}})), history(keep),
+        autoConnect(autoConnecting)
+    {}
+    // Set once by the operator that creates the hub.
+    template <typename Upstream>
+    void from(Upstream* src, std::shared_ptr<SubscriberBase> owner)
+    {
+        upstreamOwner = std::move(owner);
+        connector = [this, src]() {
+            std::weak_ptr<Multicast> weak = this->weak_from_this();
+            src->rootAdaptee()->whenFinished([weak]() {
+                if (auto hub = weak.lock())
+                {
+                    hub->finish();
+                }
+            });
+            src->subscribe([weak](T&& v, auto&& reqNext) {
+                if (auto hub = weak.lock())
+                {
+                    hub->push(std::move(v), reqNext);
+                }
+            });
+        };
+    }
+    Flux<T> asFlux()
+    {
+        auto cursor = std::make_shared<Cursor>();
+        {
+            std::lock_guard guard(lock);
+            auto end = base + ring.size();
+            cursor->next = end - std::min(history, ring.size());
+            cursors.push_back(cursor);
+        }
+        return Flux<T>{new Source(this->shared_from_this(), cursor)};
+    }
+    void connect()
+    {
+        std::unique_lock guard(lock);
+        if (std::exchange(connected, true))
+        {
+            return;
+        }
+        auto start = std::move(connector);
+        guard.unlock();
+        if (start)
+        {
+            start();
+        }
+    }
+    std::size_t subscribers()
+    {
+        std::lock_guard guard(lock);
+        return cursors.size();
+    }
+
+  private:
+    // Call with lock held.
+    bool hasRoom() const
+    {
+        return !ring.full() ||
+               std::ranges::all_of(cursors, [this](const auto& c) {
+            return c->next > base;
+        });
+    }
+    void push(T&& v, const CompletionToken& reqNext)
+    {
+        std::vector<std::pair<Consumer, T>> wake;
+        bool room = false;
+        {
+            std::lock_guard guard(lock);
+            upstream = reqNext;
+            if (ring.full())
+            {
+                ring.pop_front();
+                ++base;
+                // A subscriber that joined on a full ring starts at the
+                // value just dropped; it loses that one, not its place.
+                for (auto& c : cursors)
+                {
+                    c->next = std::max(c->next, base);
+                }
+            }
+            ring.push_back(std::move(v));
+            for (auto& c : cursors)
+            {
+                if (c->waiting && c->next < base + ring.size())
+                {
+                    wake.emplace_back(std::exchange(c->waiting, nullptr),
+                                      ring[c->next++ - base]);
+                }
+            }
+            room = hasRoom();
+            paused = !room;
+        }
+        for (auto& [consumer, value] : wake)
+        {
+            consumer(std::move(value));
+        }
+        if (room)
+        {
+            reqNext.request(1);
+        }
+    }
+    void finish()
+    {
+        std::vector<typename FluxBase<T>::SourceHandler*> idle;
+        {
+            std::lock_guard guard(lock);
+            completed = true;
+            for (auto& c : cursors)
+            {
+                if (std::exchange(c->waiting, nullptr))
+                {
+                    idle.push_back(c->source);
+                }
+            }
+        }
+        for (auto* source : idle)
+        {
+            source->complete();
+        }
+    }
+    void pull(Source* source, const std::shared_ptr<Cursor>& cursor,
+              Consumer consumer)
+    {
+        std::unique_lock guard(lock);
+        cursor->source = source;
+        if (cursor->next < base + ring.size())
+        {
+            T value = ring[cursor->next++ - base];
+            auto up = resumeUpstream();
+            guard.unlock();
+            consumer(std::move(value));
+            up.request(1);
+            return;
+        }
+        if (completed)
+        {
+            guard.unlock();
+            source->complete();
+            return;
+        }
+        cursor->waiting = std::move(consumer);
+        bool start = autoConnect && !connected;
+        guard.unlock();
+        if (start)
+        {
+            connect();
+        }
+    }
+    bool hasNext(const Cursor& cursor)
+    {
+        std::lock_guard guard(lock);
+        return !completed || cursor.next < base + ring.size();
+    }
+    void leave(const std::shared_ptr<Cursor>& cursor)
+    {
+        std::unique_lock guard(lock);
+        std::erase(cursors, cursor);
+        auto up = resumeUpstream();
+        guard.unlock();
+        up.request(1);
+    }
+    // Call with lock held; the token is empty unless the upstream was
+    // paused and there is room again.
+    CompletionToken resumeUpstream()
+    {
+        if (!paused || !hasRoom())
+        {
+            return {};
+        }
+        paused = false;
+        return upstream;
+    }
+};
+
+// Memoizes a one-shot source such as a login request. Every subscriber takes
+// its own Mono from asMono(). The first one makes the cache call the factory
+// for a fresh publisher; subscribers arriving while that fetch is in flight
+// wait for the same result instead of starting their own. The value is then
+// replayed until it is ttl old. With refreshAhead set, the first subscriber
+// within that window of the expiry starts a new fetch in the background
+// while the current value keeps being served. A fetch that ends empty
+// completes the waiting monos empty and leaves any older value in place;
+// values failing the cacheWhen() predicate are handed to the waiters but
+// not kept.
+template <typename T>
+class MonoCache : public std::enable_shared_from_this<MonoCache<T>>
+{
+  public:
+    using Clock = TimerWheel::Clock;
+    using Duration = TimerWheel::Duration;
+    using Fetch = std::function<std::shared_ptr<FluxBase<T>>()>;
+
+  private:
+    using Consumer = std::function<void(T)>;
+    struct Waiter;
+    struct Source : FluxBase<T>::SourceHandler
+    {
+        std::shared_ptr<MonoCache> cache;
+        // Set while waiting for a fetch; guarded by the cache's lock.
+        std::shared_ptr<Waiter> waiter;
+        bool mHasNext{true};
+        explicit Source(std::shared_ptr<MonoCache> c) : cache(std::move(c)) {}
+        ~Source() override
+        {
+            cache->leave(this);
+        }
+        void next(Consumer consumer) override
+        {
+            mHasNext = false;
+            cache->get(this, std::move(consumer));
+        }
+        bool hasNext() const override
+        {
+            return mHasNext;
+        }
+        void cancel() override
+        {
+            cache->leave(this);
+        }
+    };
+    // The consumer captures the mono that waits; a mono that goes away or
+    // cancels empties its waiter, and the fetch skips it.
+    struct Waiter
+    {
+        Source* source;
+        Consumer consumer;
+    };
+
+    std::mutex lock;
+    Fetch fetch;
+    Duration ttl;
+    Duration refreshAhead;
+    std::function<bool(const T&)> keep;
+    std::optional<T> value;
+    Clock::time_point expires{};
+    bool fetching{false};
+    std::vector<std::shared_ptr<Waiter>> waiting;
+    std::shared_ptr<FluxBase<T>> inflight;
+    std::size_t fetched{0};
+
+  public:
+    MonoCache(Fetch f, Duration t, Duration ahead) :
+        fetch(std::move(f)), ttl(t), refreshAhead(ahead)
+    {}
+    MonoCache& cacheWhen(std::function<bool(const T&)> pred)
+    {
+        std::lock_guard guard(lock);
+        keep = std::move(pred);
         return *this;
     }
+    Mono<T> asMono()
+    {
+        return Mono<T>{new Source(this->shared_from_this())};
+    }
+    // Drops the value; the next subscriber fetches again.
+    void invalidate()
+    {
+        std::lock_guard guard(lock);
+        value.reset();
+    }
+    std::size_t fetches()
+    {
+        std::lock_guard guard(lock);
+        return fetched;
+    }
+
+  private:
+    void get(Source* source, Consumer consumer)
+    {
+        std::unique_lock guard(lock);
+        auto now = Clock::now();
+        if (value && now < expires)
+        {
+            T v = *value;
+            bool refresh = refreshAhead > Duration::zero() &&
+                           now >= expires - refreshAhead &&
+                           !std::exchange(fetching, true);
+            guard.unlock();
+            consumer(std::move(v));
+            if (refresh)
+            {
+                start();
+            }
+            return;
+        }
+        source->waiter =
+            std::make_shared<Waiter>(Waiter{source, std::move(consumer)});
+        waiting.push_back(source->waiter);
+        if (std::exchange(fetching, true))
+        {
+            return;
+        }
+        guard.unlock();
+        start();
+    }
+    void start()
+    {
+        auto publisher = fetch();
+        {
+            std::lock_guard guard(lock);
+            ++fetched;
+            inflight = publisher;
+        }
+        auto settled = std::make_shared<bool>(false);
+        std::weak_ptr<MonoCache> weak = this->weak_from_this();
+        publisher->whenFinished([weak, settled]() {
+            auto self = weak.lock();
+            if (self && !std::exchange(*settled, true))
+            {
+                self->done(std::nullopt);
+            }
+        });
+        publisher->subscribe([weak, settled](T&& v) {
+            auto self = weak.lock();
+            if (self && !std::exchange(*settled, true))
+            {
+                self->done(std::move(v));
+            }
+        });
+    }
+    void done(std::optional<T> v)
+    {
+        std::unique_lock guard(lock);
+        fetching = false;
+        auto waiters = std::move(waiting);
+        waiting.clear();
+        if (v && (!keep || keep(*v)))
+        {
+            value = *v;
+            expires = Clock::now() + ttl;
+        }
+        // The publisher is still running this callback; FluxBase keeps
+        // itself alive until it unwinds.
+        auto finished = std::move(inflight);
+        guard.unlock();
+        // A consumer may drop the monos still waiting behind it.
+        for (auto& w : waiters)
+        {
+            guard.lock();
+            auto* source = std::exchange(w->source, nullptr);
+            auto consumer = std::move(w->consumer);
+            if (source != nullptr)
+            {
+                source->waiter.reset();
+            }
+            guard.unlock();
+            if (source == nullptr)
+            {
+                continue;
+            }
+            if (v)
+            {
+                consumer(*v);
+            }
+            else
+            {
+                source->complete();
+            }
+        }
+    }
+    void leave(Source* source)
+    {
+        std::lock_guard guard(lock);
+        auto w = std::move(source->waiter);
+        if (!w)
+        {
+            return;
+        }
+        w->source = nullptr;
+        w->consumer = nullptr;
+        std::erase(waiting, w);
+    }
+};
+template <typename P>
+concept Publisher = requires {
+    typename InnerPublisher<std::decay_t<P>>::type::value_type;
+} && std::derived_from<
+    typename InnerPublisher<std::decay_t<P>>::type,
+    FluxBase<typename InnerPublisher<std::decay_t<P>>::type::value_type>>;
+
+template <Publisher P>
+using PublisherType = typename InnerPublisher<std::decay_t<P>>::type;
+
+// One input of a combinator. It holds at most one value the combinator has
+// not taken yet; the next value is only asked for once it has.
+template <typename P>
+struct CombineLink
+{
+    using value_type = typename P::value_type;
+    std::shared_ptr<P> publisher;
+    std::optional<value_type> value;
+    CompletionToken token;
+    bool started{false};
+    bool requested{false};
+    bool finished{false};
+    explicit CombineLink(std::shared_ptr<P> p) : publisher(std::move(p)) {}
+    bool dry() const
+    {
+        return finished && !value;
+    }
+    void pull(auto onValue, auto onDone)
+    {
+        if (finished || requested || value)
+        {
+            return;
+        }
+        requested = true;
+        if (started)
+        {
+            token.request(1);
+            return;
+        }
+        started = true;
+        publisher->whenFinished([this, onDone]() {
+            finished = true;
+            requested = false;
+            onDone();
+        });
+        publisher->subscribe(
+            [this, onValue](value_type&& v, auto&& reqNext) {
+            token = reqNext;
+            requested = false;
+            value.emplace(std::move(v));
+            onValue();
+        });
+    }
+    value_type take()
+    {
+        value_type v = std::move(*value);
+        value.reset();
+        return v;
+    }
+};
+
+// Links come either as a tuple (heterogeneous, sized at compile time) or as
+// a vector (one publisher type, sized at run time). These helpers hide the
+// difference; the index handed to the callback is a constant for tuples.
+template <typename... Links, typename Func>
+void forEachLink(std::tuple<Links...>& links, Func&& func)
+{
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        (func(std::get<I>(links), std::integral_constant<std::size_t, I>{}),
+         ...);
+    }(std::index_sequence_for<Links...>{});
+}
+template <typename Link, typename Func>
+void forEachLink(std::vector<Link>& links, Func&& func)
+{
+    for (std::size_t i = 0; i < links.size(); ++i)
+    {
+        func(links[i], i);
+    }
+}
+template <typename... Links, typename Func>
+void withLink(std::tuple<Links...>& links, std::size_t index, Func&& func)
+{
+    forEachLink(links, [&](auto& link, auto i) {
+        if (i == index)
+        {
+            func(link, i);
+        }
+    });
+}
+template <typename Link, typename Func>
+void withLink(std::vector<Link>& links, std::size_t index, Func&& func)
+{
+    func(links[index], index);
+}
+template <typename Links>
+std::size_t linkCount(const Links& links)
+{
+    if constexpr (requires { links.size(); })
+    {
+        return links.size();
+    }
+    else
+    {
+        return std::tuple_size_v<Links>;
+    }
+}
+
+// Source side of zip/merge/combineLatest/concat/whenAll/whenAny. A
+// combinator is an ordinary SourceHandler, so the result is a plain Flux or
+// Mono that chains like any other. Inputs may deliver from different
+// threads; the recursive lock also lets sync inputs deliver inline.
+template <typename Out, typename Links>
+struct Combinator : FluxBase<Out>::SourceHandler
+{
+    Links links;
+    std::recursive_mutex lock;
+    std::function<void(Out)> pending;
+
+    explicit Combinator(Links l) : links(std::move(l)) {}
+    void next(std::function<void(Out)> consumer) final
+    {
+        std::lock_guard guard(lock);
+        pending = std::move(consumer);
+        onNext();
+    }
+    bool hasNext() const final
+    {
+        auto& self = const_cast<Combinator&>(*this);
+        std::lock_guard guard(self.lock);
+        return self.more();
+    }
+
+  protected:
+    virtual void onNext() = 0;
+    virtual void onValue(std::size_t index) = 0;
+    virtual bool more() = 0;
+    void pull(auto& link, std::size_t index)
+    {
+        link.pull([this, index]() { valueArrived(index); },
+                  [this]() { linkFinished(); });
+    }
+    void pullAll()
+    {
+        forEachLink(links, [this](auto& link, auto i) { pull(link, i); });
+    }
+    bool all(auto pred)
+    {
+        bool result = true;
+        forEachLink(links,
+                    [&](auto& link, auto) { result = result && pred(link); });
+        return result;
+    }
+    bool any(auto pred)
+    {
+        return !all([&](auto& link) { return !pred(link); });
+    }
+    void emit(Out out)
+    {
+        auto consumer = std::exchange(pending, nullptr);
+        consumer(std::move(out));
+    }
+
+  private:
+    void valueArrived(std::size_t index)
+    {
+        std::lock_guard guard(lock);
+        onValue(index);
+    }
+    void linkFinished()
+    {
+        std::lock_guard guard(lock);
+        if (!pending)
+        {
+            return;
+        }
+        if (!more())
+        {
+            pending = nullptr;
+            this->complete();
+            return;
+        }
+        onNext();
+    }
+};
 
-    auto map(MapFunction<T> auto mapFun)
-    {
-        using FuncType = decltype(mapFun);
-        using DestType = std::invoke_result_t<FuncType, T>;
-        auto adapter = new Adapter<T, DestType, FluxBase>(std::move(mapFun),
-                                                          this);
-        addToMappers(adapter);
-        return *adapter;
-    }
-    auto filter(FilterFunction<T> auto filtFun)
+// Pairs up the n-th value of every input. Each round waits for all inputs;
+// the values sit in the links' own slots, so a round allocates nothing but
+// the result. whenAll is a single round.
+template <typename Out, typename Links>
+struct ZipSource : Combinator<Out, Links>
+{
+    using Base = Combinator<Out, Links>;
+    std::size_t rounds;
+    ZipSource(Links l, std::size_t r) : Base(std::move(l)), rounds(r) {}
+    void onNext() override
     {
-        auto identityfunc = [](const T& v) { return v; };
-        auto adapter =
-            new Adapter<T, T, FluxBase, true>(std::move(identityfunc), this);
-        adapter->setFilter(std::move(filtFun));
-        addToMappers(adapter);
-        return *adapter;
+        Base::pullAll();
+        tryEmit();
     }
-
-    auto rootAdaptee()
+    void onValue(std::size_t) override
     {
-        return this;
+        tryEmit();
     }
-    void addToMappers(SubscriberBase* mapper)
+    bool more() override
     {
-        mapHandlers.push_back(std::unique_ptr<SubscriberBase>(mapper));
+        return rounds > 0 &&
+               !Base::any([](auto& link) { return link.dry(); });
     }
-    auto getSharedPtr()
+    void tryEmit()
     {
-        return Base::shared_from_this();
+        if (!Base::pending ||
+            !Base::all([](auto& link) { return link.value.has_value(); }))
+        {
+            return;
+        }
+        --rounds;
+        Base::emit(collect());
     }
-};
-template <typename T>
-struct Mono : FluxBase<T>
-{
-    using Base = FluxBase<T>;
-    struct Just : Base::SourceHandler
+    Out collect()
     {
-        T value{};
-        bool mHasNext{true};
-        explicit Just(T v) : value(std::move(v)) {}
-        void next(std::function<void(T)> consumer) override
+        if constexpr (requires { Base::links.size(); })
         {
-            mHasNext = false;
-            consumer(std::move(value));
+            Out out;
+            out.reserve(Base::links.size());
+            for (auto& link : Base::links)
+            {
+                out.push_back(link.take());
+            }
+            return out;
         }
-        bool hasNext() const override
+        else
         {
-            return mHasNext;
+            return std::apply(
+                [](auto&... link) { return Out{link.take()...}; },
+                Base::links);
         }
-    };
+    }
+};
 
-    explicit Mono(Base::SourceHandler* srcHandler) : Base(srcHandler) {}
-    Mono() : Base(nullptr) {}
-    static Mono just(T v)
+// Forwards values from all inputs in arrival order.
+template <typename Out, typename Links>
+struct MergeSource : Combinator<Out, Links>
+{
+    using Base = Combinator<Out, Links>;
+    std::deque<std::size_t> arrivals;
+    using Base::Base;
+    void onNext() override
     {
-        return Mono{new Just(std::move(v))};
+        Base::pullAll();
+        deliver();
     }
-    static std::shared_ptr<Mono> justPtr(T v)
+    void onValue(std::size_t index) override
     {
-        return std::make_shared<Mono>(new Just(std::move(v)));
+        arrivals.push_back(index);
+        deliver();
     }
-    struct Generator : Base::SourceHandler
+    bool more() override
     {
-        using GeneratorFunc = std::function<T()>;
-        GeneratorFunc generator;
-        bool mHasNext{true};
-        explicit Generator(GeneratorFunc f) : generator(std::move(f)) {}
-        void next(std::function<void(T)> consumer) override
-        {
-            mHasNext = false;
-            consumer(generator());
-        }
-        bool hasNext() const override
+        return !Base::all([](auto& link) { return link.dry(); });
+    }
+    void deliver()
+    {
+        if (!Base::pending || arrivals.empty())
         {
-            return mHasNext;
+            return;
         }
-    };
-    static Mono justFrom(Generator::GeneratorFunc f)
+        auto index = arrivals.front();
+        arrivals.pop_front();
+        std::optional<Out> out;
+        withLink(Base::links, index,
+                 [&out](auto& link, auto) { out.emplace(link.take()); });
+        Base::emit(std::move(*out));
+    }
+};
+
+// Emits the latest value of every input each time one of them changes, once
+// all of them have produced something.
+template <typename Out, typename Links>
+struct CombineLatestSource : Combinator<Out, Links>
+{
+    using Base = Combinator<Out, Links>;
+    std::deque<std::size_t> arrivals;
+    decltype(std::apply(
+        [](auto&... link) {
+        return std::tuple<std::optional<
+            typename std::decay_t<decltype(link)>::value_type>...>{};
+    },
+        std::declval<Links&>())) latest;
+    using Base::Base;
+    void onNext() override
     {
-        return Mono{new Generator(std::move(f))};
+        Base::pullAll();
+        deliver();
     }
-    static std::shared_ptr<Mono> justPtr(Generator::GeneratorFunc f)
+    void onValue(std::size_t index) override
     {
-        return std::make_shared<Mono>(new Generator(std::move(f)));
+        arrivals.push_back(index);
+        deliver();
+    }
+    bool more() override
+    {
+        bool missing = false;
+        forEachLink(Base::links, [&](auto& link, auto i) {
+            missing = missing ||
+                      (link.dry() && !std::get<decltype(i)::value>(latest));
+        });
+        return !missing && !(arrivals.empty() &&
+                             Base::all([](auto& link) { return link.dry(); }));
+    }
+    void deliver()
+    {
+        while (Base::pending && !arrivals.empty())
+        {
+            auto index = arrivals.front();
+            arrivals.pop_front();
+            withLink(Base::links, index, [this](auto& link, auto i) {
+                std::get<decltype(i)::value>(latest) = link.take();
+            });
+            if (std::apply([](auto&... v) { return (v.has_value() && ...); },
+                           latest))
+            {
+                Base::emit(std::apply(
+                    [](auto&... v) { return Out{*v...}; }, latest));
+                return;
+            }
+            Base::pullAll();
+        }
     }
 };
 
-template <typename T>
-struct Flux : FluxBase<T>
+// Drains the inputs one after the other.
+template <typename Out, typename Links>
+struct ConcatSource : Combinator<Out, Links>
 {
-    using Base = FluxBase<T>;
-    template <class R>
-    struct Range : Base::SourceHandler
+    using Base = Combinator<Out, Links>;
+    std::size_t current{0};
+    using Base::Base;
+    void onNext() override
     {
-        R range{};
-        R::iterator current{};
-        explicit Range(R v) : range(std::move(v)), current(range.begin()) {}
-        void next(std::function<void(T)> consumer) override
+        while (Base::pending && current < linkCount(Base::links))
         {
-            T v = std::move(*current);
+            bool dry = false;
+            withLink(Base::links, current, [this, &dry](auto& link, auto i) {
+                dry = link.dry();
+                if (!dry)
+                {
+                    this->pull(link, i);
+                }
+            });
+            if (!dry)
+            {
+                deliver();
+                return;
+            }
             ++current;
-            consumer(std::move(v));
-        }
-        bool hasNext() const override
-        {
-            return current != range.end();
         }
-    };
-
-    explicit Flux(Base::SourceHandler* srcHandler) : Base(srcHandler) {}
-    Flux() : Base(nullptr) {}
-    template <class R>
-    static Flux range(R v)
+    }
+    void onValue(std::size_t) override
     {
-        return Flux{new Range<R>(std::move(v))};
+        deliver();
     }
-
-    struct Generator : Base::SourceHandler
+    bool more() override
     {
-        using GeneratorFunc = std::function<T(bool& next)>;
-        GeneratorFunc generator;
-        bool nextFound{true};
-        explicit Generator(GeneratorFunc f) : generator(std::move(f)) {}
-        void next(std::function<void(T)> consumer) override
+        std::size_t index = 0;
+        bool result = false;
+        forEachLink(Base::links, [&](auto& link, auto) {
+            result = result || (index++ >= current && !link.dry());
+        });
+        return result;
+    }
+    void deliver()
+    {
+        if (!Base::pending || current >= linkCount(Base::links))
         {
-            consumer(generator(nextFound));
+            return;
         }
-        bool hasNext() const override
+        std::optional<Out> out;
+        withLink(Base::links, current, [&out](auto& link, auto) {
+            if (link.value)
+            {
+                out.emplace(link.take());
+            }
+        });
+        if (out)
         {
-            return nextFound;
+            Base::emit(std::move(*out));
         }
-    };
+    }
+};
 
-    static Flux generate(Generator::GeneratorFunc f)
+// Emits the first value any input produces and cancels the others.
+template <typename Out, typename Links>
+struct AnySource : Combinator<Out, Links>
+{
+    using Base = Combinator<Out, Links>;
+    bool won{false};
+    using Base::Base;
+    void onNext() override
     {
-        return Flux{new Generator(std::move(f))};
+        Base::pullAll();
+    }
+    void onValue(std::size_t index) override
+    {
+        if (won || !Base::pending)
+        {
+            return;
+        }
+        won = true;
+        std::optional<Out> out;
+        withLink(Base::links, index, [&out](auto& link, auto i) {
+            if constexpr (std::is_integral_v<decltype(i)>)
+            {
+                out.emplace(link.take());
+            }
+            else
+            {
+                out.emplace(std::in_place_index<decltype(i)::value>,
+                            link.take());
+            }
+        });
+        forEachLink(Base::links, [index](auto& link, std::size_t i) {
+            if (i != index)
+            {
+                link.publisher->cancel();
+            }
+        });
+        Base::emit(std::move(*out));
+    }
+    bool more() override
+    {
+        return !won && !Base::all([](auto& link) { return link.dry(); });
     }
 };
+
+template <typename... Ps>
+auto makeLinks(Ps&&... sources)
+{
+    return std::tuple<CombineLink<PublisherType<Ps>>...>(
+        InnerPublisher<std::decay_t<Ps>>::share(std::forward<Ps>(sources))...);
+}
+template <typename P>
+auto makeLinks(std::vector<std::shared_ptr<P>> sources)
+{
+    std::vector<CombineLink<P>> links;
+    links.reserve(sources.size());
+    for (auto& source : sources)
+    {
+        links.emplace_back(std::move(source));
+    }
+    return links;
+}
+
+template <Publisher... Ps>
+auto zip(Ps&&... sources)
+{
+    using Out = std::tuple<typename PublisherType<Ps>::value_type...>;
+    auto links = makeLinks(std::forward<Ps>(sources)...);
+    return Flux<Out>{new ZipSource<Out, decltype(links)>(
+        std::move(links), std::numeric_limits<std::size_t>::max())};
+}
+template <Publisher... Ps>
+auto combineLatest(Ps&&... sources)
+{
+    using Out = std::tuple<typename PublisherType<Ps>::value_type...>;
+    auto links = makeLinks(std::forward<Ps>(sources)...);
+    return Flux<Out>{
+        new CombineLatestSource<Out, decltype(links)>(std::move(links))};
+}
+template <Publisher... Ps>
+auto merge(Ps&&... sources)
+{
+    using Out = std::common_type_t<typename PublisherType<Ps>::value_type...>;
+    auto links = makeLinks(std::forward<Ps>(sources)...);
+    return Flux<Out>{new MergeSource<Out, decltype(links)>(std::move(links))};
+}
+template <typename P>
+auto merge(std::vector<std::shared_ptr<P>> sources)
+{
+    using Out = typename P::value_type;
+    auto links = makeLinks(std::move(sources));
+    return Flux<Out>{new MergeSource<Out, decltype(links)>(std::move(links))};
+}
+template <Publisher... Ps>
+auto concat(Ps&&... sources)
+{
+    using Out = std::common_type_t<typename PublisherType<Ps>::value_type...>;
+    auto links = makeLinks(std::forward<Ps>(sources)...);
+    return Flux<Out>{new ConcatSource<Out, decltype(links)>(std::move(links))};
+}
+template <typename P>
+auto concat(std::vector<std::shared_ptr<P>> sources)
+{
+    using Out = typename P::value_type;
+    auto links = makeLinks(std::move(sources));
+    return Flux<Out>{new ConcatSource<Out, decltype(links)>(std::move(links))};
+}
+template <Publisher... Ps>
+auto whenAll(Ps&&... sources)
+{
+    using Out = std::tuple<typename PublisherType<Ps>::value_type...>;
+    auto links = makeLinks(std::forward<Ps>(sources)...);
+    return Mono<Out>{new ZipSource<Out, decltype(links)>(std::move(links), 1)};
+}
+// Results land at the index of their publisher.
+template <typename P>
+auto whenAll(std::vector<std::shared_ptr<P>> sources)
+{
+    using Out = std::vector<typename P::value_type>;
+    auto links = makeLinks(std::move(sources));
+    return Mono<Out>{new ZipSource<Out, decltype(links)>(std::move(links), 1)};
+}
+template <Publisher... Ps>
+auto whenAny(Ps&&... sources)
+{
+    using Out = std::variant<typename PublisherType<Ps>::value_type...>;
+    auto links = makeLinks(std::forward<Ps>(sources)...);
+    return Mono<Out>{new AnySource<Out, decltype(links)>(std::move(links))};
+}
+template <typename P>
+auto whenAny(std::vector<std::shared_ptr<P>> sources)
+{
+    using Out = typename P::value_type;
+    auto links = makeLinks(std::move(sources));
+    return Mono<Out>{new AnySource<Out, decltype(links)>(std::move(links))};
+}
+
+// Sink groups fan one value out to a fixed set of sinks. The sinks live in a
+// std::tuple, so broadcasting is one direct call per sink with nothing
+// allocated per element.
 template <typename SourceType, typename... SinkTypes>
 struct AsyncSinkGroup
 {
-    using TargetSinkType = std::variant<SinkTypes...>;
-
-    using Sinks = std::vector<TargetSinkType>;
+    // Handed to every sink as its completion callback; small enough for
+    // std::function's inline buffer should a sink store it in one.
+    struct SinkCallback
+    {
+        AsyncSinkGroup* group;
+        void operator()(bool next) const
+        {
+            group->handleSinkCallback(next);
+        }
+    };
+    using Sinks = std::tuple<SinkTypes...>;
+    static constexpr std::size_t sinkCount = sizeof...(SinkTypes);
     Sinks targetSinks;
-    Sinks tobeCleared;
-    std::function<void(bool)> requestNext;
+    CompletionToken requestNext;
     bool nextNeeded{false};
-    int sinkExecutionCount{0};
-    AsyncSinkGroup(Sinks sinks) : targetSinks(std::move(sinks)) {}
+    std::size_t sinkExecutionCount{0};
+    explicit AsyncSinkGroup(SinkTypes... sinks) :
+        targetSinks(std::move(sinks)...)
+    {}
     void handleSinkCallback(bool next)
     {
         sinkExecutionCount++;
         nextNeeded |= next;
-        if (sinkExecutionCount == targetSinks.size())
+        if (sinkExecutionCount == sinkCount)
         {
             requestNext(nextNeeded);
         }
     }
-    void process(const SourceType& res, auto& vsink)
-    {
-        std::visit(
-            [&res, this](auto& sink) {
-            sink(res,
-                 std::bind_front(&AsyncSinkGroup::handleSinkCallback, this));
-        },
-            vsink);
-    }
     void operator()(const SourceType& res, auto&& reqNext)
     {
         requestNext = std::move(reqNext);
         sinkExecutionCount = 0;
         nextNeeded = false;
-        for (auto& sink : targetSinks)
-        {
-            process(res, sink);
-        }
+        std::apply(
+            [&res, this](auto&... sink) {
+            (sink(res, SinkCallback{this}), ...);
+        },
+            targetSinks);
     }
 };
 
 template <typename SourceType, typename... SinkTypes>
 struct SyncSinkGroup
 {
-    using TargetSinkType = std::variant<SinkTypes...>;
-
-    using Sinks = std::vector<TargetSinkType>;
+    using Sinks = std::tuple<SinkTypes...>;
     Sinks targetSinks;
 
-    SyncSinkGroup(Sinks sinks) : targetSinks(std::move(sinks)) {}
+    explicit SyncSinkGroup(SinkTypes... sinks) :
+        targetSinks(std::move(sinks)...)
+    {}
 
-    void process(const SourceType& res, auto& vsink)
+    void operator()(const SourceType& res)
     {
-        std::visit([&res](auto& sink) { sink(res); }, vsink);
+        std::apply([&res](auto&... sink) { (sink(res), ...); }, targetSinks);
     }
-    void operator()(const SourceType& res)
+};
+enum class OverflowPolicy
+{
+    DropOldest, // overwrite the oldest queued value
+    DropNewest, // discard the incoming value
+    Block,      // hold the upstream until this sink has room
+    Spill       // park the overflow in an unbounded side queue
+};
+struct LaneOptions
+{
+    std::size_t capacity{64};
+    // Values handed to the sink before it reports back. Keep it at one for
+    // sinks that cannot overlap requests, such as HttpSink.
+    std::size_t window{1};
+    OverflowPolicy policy{OverflowPolicy::DropOldest};
+};
+struct LaneStats
+{
+    std::size_t lag{0}; // queued and spilled, not yet handed to the sink
+    std::size_t inFlight{0};
+    std::size_t delivered{0};
+    std::size_t dropped{0};
+    std::size_t spilled{0};
+    bool closed{false};
+};
+template <typename Sink>
+struct SinkLane
+{
+    Sink sink;
+    LaneOptions options;
+};
+template <typename Sink>
+inline auto makeLane(Sink sink, LaneOptions options = {})
+{
+    return SinkLane<Sink>{std::move(sink), options};
+}
+
+// Broadcast that does not wait for the slowest sink. Every sink gets its own
+// bounded queue and in-flight window, and the upstream is asked for more as
+// soon as the value is queued everywhere, unless a Block lane is full. A
+// sink that reports back false is closed; the broadcast ends once all are.
+// The group is a handle to shared state, so a copy kept by the caller reads
+// the lane stats while the subscribed copy runs.
+template <typename SourceType, typename... SinkTypes>
+class DecoupledSinkGroup
+{
+    template <typename Sink>
+    struct Lane
+    {
+        Sink sink;
+        LaneOptions options;
+        boost::circular_buffer<SourceType> queue;
+        std::deque<SourceType> spill;
+        LaneStats stats;
+        bool pumping{false};
+        explicit Lane(SinkLane<Sink> lane) :
+            sink(std::move(lane.sink)), options(lane.options),
+            queue(std::max<std::size_t>(lane.options.capacity, 1))
+        {}
+    };
+    struct State
     {
-        for (auto& vsink : targetSinks)
+        std::tuple<Lane<SinkTypes>...> lanes;
+        std::optional<CompletionToken> held;
+
+        explicit State(SinkLane<SinkTypes>... lanes) :
+            lanes(Lane<SinkTypes>(std::move(lanes))...)
+        {}
+        template <std::size_t I>
+        struct LaneCallback
+        {
+            State* state;
+            void operator()(bool next) const
+            {
+                state->template done<I>(next);
+            }
+        };
+        void push(const SourceType& res, CompletionToken&& reqNext)
+        {
+            forEachLane([&res, this](auto index) {
+                offer<decltype(index)::value>(res);
+                pump<decltype(index)::value>();
+            });
+            held = std::move(reqNext);
+            release();
+        }
+        template <std::size_t I>
+        void offer(const SourceType& res)
+        {
+            auto& lane = std::get<I>(lanes);
+            if (lane.stats.closed)
+            {
+                return;
+            }
+            auto policy = lane.options.policy;
+            if (policy == OverflowPolicy::Spill && !lane.spill.empty())
+            {
+                lane.spill.push_back(res);
+                ++lane.stats.spilled;
+            }
+            else if (!lane.queue.full())
+            {
+                lane.queue.push_back(res);
+            }
+            else if (policy == OverflowPolicy::DropOldest)
+            {
+                lane.queue.push_back(res);
+                ++lane.stats.dropped;
+            }
+            else if (policy == OverflowPolicy::Spill)
+            {
+                lane.spill.push_back(res);
+                ++lane.stats.spilled;
+            }
+            else
+            {
+                ++lane.stats.dropped;
+            }
+        }
+        template <std::size_t I>
+        void pump()
         {
-            process(res, vsink);
+            auto& lane = std::get<I>(lanes);
+            if (lane.pumping)
+            {
+                return;
+            }
+            lane.pumping = true;
+            while (!lane.stats.closed &&
+                   lane.stats.inFlight < lane.options.window &&
+                   !lane.queue.empty())
+            {
+                auto res = std::move(lane.queue.front());
+                lane.queue.pop_front();
+                if (!lane.spill.empty())
+                {
+                    lane.queue.push_back(std::move(lane.spill.front()));
+                    lane.spill.pop_front();
+                }
+                ++lane.stats.inFlight;
+                lane.sink(res, LaneCallback<I>{this});
+            }
+            lane.pumping = false;
+        }
+        template <std::size_t I>
+        void done(bool next)
+        {
+            auto& lane = std::get<I>(lanes);
+            --lane.stats.inFlight;
+            ++lane.stats.delivered;
+            if (!next && !lane.stats.closed)
+            {
+                lane.stats.closed = true;
+                lane.stats.dropped += lane.queue.size() + lane.spill.size();
+                lane.queue.clear();
+                lane.spill.clear();
+            }
+            pump<I>();
+            release();
+        }
+        // Hands the held request upstream unless a Block lane is full.
+        // Once every lane is closed the token is dropped, ending the flow.
+        void release()
+        {
+            if (!held)
+            {
+                return;
+            }
+            bool blocked = false;
+            bool open = false;
+            forEachLane([&](auto index) {
+                auto& lane = std::get<decltype(index)::value>(lanes);
+                open = open || !lane.stats.closed;
+                blocked = blocked ||
+                          (!lane.stats.closed &&
+                           lane.options.policy == OverflowPolicy::Block &&
+                           lane.queue.full());
+            });
+            if (blocked)
+            {
+                return;
+            }
+            auto token = *held;
+            held.reset();
+            if (open)
+            {
+                token.request(1);
+            }
         }
+        template <typename Func>
+        void forEachLane(Func&& func)
+        {
+            [&]<std::size_t... I>(std::index_sequence<I...>) {
+                (func(std::integral_constant<std::size_t, I>{}), ...);
+            }(std::index_sequence_for<SinkTypes...>{});
+        }
+    };
+    std::shared_ptr<State> state;
+
+  public:
+    explicit DecoupledSinkGroup(SinkLane<SinkTypes>... lanes) :
+        state(std::make_shared<State>(std::move(lanes)...))
+    {}
+    void operator()(const SourceType& res, auto&& reqNext)
+    {
+        state->push(res, std::move(reqNext));
+    }
+    LaneStats laneStats(std::size_t index) const
+    {
+        LaneStats stats;
+        state->forEachLane([&](auto i) {
+            if (i == index)
+            {
+                auto& lane = std::get<decltype(i)::value>(state->lanes);
+                stats = lane.stats;
+                stats.lag = lane.queue.size() + lane.spill.size();
+            }
+        });
+        return stats;
     }
 };
 template <typename T, typename... Sink>
+inline auto createDecoupledSinkGroup(SinkLane<Sink>... lanes)
+{
+    return DecoupledSinkGroup<T, Sink...>{std::move(lanes)...};
+}
+template <typename T, typename... Sink>
 inline auto createSinkGroup(Sink... sink)
 {
-    using BroadCaster = SyncSinkGroup<T, Sink...>;
-    using BroadCasterSinks = typename BroadCaster::Sinks;
-    BroadCasterSinks vecSinks{(std::move(sink), ...)};
-    return BroadCaster{std::move(vecSinks)};
+    return SyncSinkGroup<T, Sink...>{std::move(sink)...};
 }
 } // namespace reactor
@@ -0,0 +1,304 @@
+#pragma once
+#include "core/reactor.hpp"
+
+#include <boost/asio/post.hpp>
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+namespace reactor
+{
+
+// Bounded ring after Dmitry Vyukov's MPMC queue. Producers claim a cell with
+// one CAS on the enqueue position and publish it through the cell's sequence
+// number, so they never take a lock. Popping is safe from several threads
+// too, which the DropOldest strategy relies on.
+template <typename T>
+class MpscRing
+{
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence{0};
+        std::optional<T> value;
+    };
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+    alignas(64) std::atomic<std::size_t> enqueuePos{0};
+    alignas(64) std::atomic<std::size_t> dequeuePos{0};
+    alignas(64) std::atomic<std::size_t> contention{0};
+
+  public:
+    explicit MpscRing(std::size_t capacity) :
+        cells(new Cell[std::bit_ceil(std::max<std::size_t>(capacity, 2))]),
+        mask(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1)
+    {
+        for (std::size_t i = 0; i <= mask; ++i)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    // Leaves value untouched when the ring is full.
+    bool tryPush(T& value)
+    {
+        auto pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true)
+        {
+            cell = &cells[pos & mask];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto dif = static_cast<std::intptr_t>(seq) -
+                       static_cast<std::intptr_t>(pos);
+            if (dif == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+                contention.fetch_add(1, std::memory_order_relaxed);
+            }
+            else if (dif < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value.emplace(std::move(value));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    std::optional<T> tryPop()
+    {
+        auto pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true)
+        {
+            cell = &cells[pos & mask];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto dif = static_cast<std::intptr_t>(seq) -
+                       static_cast<std::intptr_t>(pos + 1);
+            if (dif == 0)
+            {
+                if (dequeuePos.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (dif < 0)
+            {
+                return std::nullopt;
+            }
+            else
+            {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        std::optional<T> value{std::move(cell->value)};
+        cell->value.reset();
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return value;
+    }
+    bool empty() const
+    {
+        return dequeuePos.load(std::memory_order_acquire) ==
+               enqueuePos.load(std::memory_order_acquire);
+    }
+    std::size_t capacity() const
+    {
+        return mask + 1;
+    }
+    // Failed claims on the enqueue position, i.e. producers that collided.
+    std::size_t contended() const
+    {
+        return contention.load(std::memory_order_relaxed);
+    }
+};
+
+enum class EmitResult
+{
+    Ok,
+    FailOverflow,
+    FailTerminated
+};
+
+enum class OverflowStrategy
+{
+    DropLatest, // reject the value being emitted
+    DropOldest, // evict the oldest queued value to make room
+    Spin        // yield until there is room; never from the consumer thread
+};
+
+struct SinkStats
+{
+    std::size_t emitted{0};
+    std::size_t dropped{0};
+    std::size_t contended{0};
+};
+
+// Hot source fed from any thread. Producers push into a bounded ring; the
+// flux from asFlux() consumes on the given executor. While values are queued
+// the consumer takes them inline, up to batchSize per task, and only parks
+// once the ring runs dry. A producer that finds the consumer parked posts a
+// single task to wake it, so quiet periods cost one post per batch rather
+// than one per value. There is a single consumer: call asFlux() once.
+template <typename T>
+class ManySink : public std::enable_shared_from_this<ManySink<T>>
+{
+    using Consumer = std::function<void(T)>;
+    struct Source : FluxBase<T>::SourceHandler
+    {
+        std::shared_ptr<ManySink> sink;
+        explicit Source(std::shared_ptr<ManySink> s) : sink(std::move(s)) {}
+        void next(Consumer consumer) override
+        {
+            sink->next(this, std::move(consumer));
+        }
+        bool hasNext() const override
+        {
+            return !sink->terminated.load(std::memory_order_acquire) ||
+                   !sink->ring.empty();
+        }
+    };
+
+    MpscRing<T> ring;
+    net::any_io_executor executor;
+    OverflowStrategy strategy;
+    std::size_t batchSize;
+    std::atomic<bool> terminated{false};
+    std::atomic<bool> parked{false};
+    std::atomic<std::size_t> emitted{0};
+    std::atomic<std::size_t> dropped{0};
+    Source* source{nullptr};
+    Consumer waiting;
+    std::size_t batch{0};
+    static inline thread_local const ManySink* draining{nullptr};
+
+  public:
+    ManySink(net::any_io_executor ex, std::size_t capacity,
+             OverflowStrategy overflow, std::size_t batch) :
+        ring(capacity), executor(std::move(ex)), strategy(overflow),
+        batchSize(std::max<std::size_t>(batch, 1))
+    {}
+    EmitResult tryEmitNext(T value)
+    {
+        if (terminated.load(std::memory_order_acquire))
+        {
+            return EmitResult::FailTerminated;
+        }
+        while (!ring.tryPush(value))
+        {
+            if (strategy == OverflowStrategy::DropLatest)
+            {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return EmitResult::FailOverflow;
+            }
+            if (strategy == OverflowStrategy::DropOldest)
+            {
+                if (ring.tryPop())
+                {
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+                continue;
+            }
+            if (terminated.load(std::memory_order_acquire))
+            {
+                return EmitResult::FailTerminated;
+            }
+            std::this_thread::yield();
+        }
+        emitted.fetch_add(1, std::memory_order_relaxed);
+        wake();
+        return EmitResult::Ok;
+    }
+    EmitResult tryEmitComplete()
+    {
+        if (terminated.exchange(true, std::memory_order_acq_rel))
+        {
+            return EmitResult::FailTerminated;
+        }
+        wake();
+        return EmitResult::Ok;
+    }
+    Flux<T> asFlux()
+    {
+        return Flux<T>{new Source(this->shared_from_this())};
+    }
+    SinkStats stats() const
+    {
+        return {emitted.load(std::memory_order_relaxed),
+                dropped.load(std::memory_order_relaxed), ring.contended()};
+    }
+
+  private:
+    void next(Source* src, Consumer consumer)
+    {
+        if (draining == this && batch < batchSize)
+        {
+            if (auto value = ring.tryPop())
+            {
+                ++batch;
+                consumer(std::move(*value));
+                return;
+            }
+        }
+        source = src;
+        waiting = std::move(consumer);
+        parked.store(true, std::memory_order_seq_cst);
+        // A producer may have pushed before seeing the flag; look again.
+        if (!ring.empty() || terminated.load(std::memory_order_seq_cst))
+        {
+            wake();
+        }
+    }
+    void wake()
+    {
+        if (parked.load(std::memory_order_seq_cst) &&
+            parked.exchange(false, std::memory_order_acq_rel))
+        {
+            net::post(executor,
+                      [self = this->shared_from_this()]() { self->resume(); });
+        }
+    }
+    void resume()
+    {
+        auto consumer = std::move(waiting);
+        auto value = ring.tryPop();
+        if (!value)
+        {
+            if (terminated.load(std::memory_order_acquire) && ring.empty())
+            {
+                source->complete();
+                return;
+            }
+            // Another producer evicted the value (DropOldest); park again.
+            next(source, std::move(consumer));
+            return;
+        }
+        draining = this;
+        batch = 1;
+        consumer(std::move(*value));
+        draining = nullptr;
+    }
+};
+
+struct Sinks
+{
+    template <typename T>
+    static std::shared_ptr<ManySink<T>>
+        many(net::any_io_executor executor, std::size_t capacity = 1024,
+             OverflowStrategy overflow = OverflowStrategy::DropLatest,
+             std::size_t batchSize = 256)
+    {
+        return std::make_shared<ManySink<T>>(std::move(executor), capacity,
+                                             overflow, batchSize);
+    }
+};
+} // namespace reactor
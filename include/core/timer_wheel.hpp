@@ -0,0 +1,257 @@
+#pragma once
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/execution_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+namespace reactor
+{
+namespace net = boost::asio;
+
+// Hashed timer wheel shared by everything scheduled on one execution
+// context. Deadlines are rounded up to whole ticks and hashed into a ring of
+// slots; a single steady_timer wakes the wheel at the next occupied slot, so
+// thousands of pending timeouts cost one asio timer rather than one each.
+// Callbacks are posted to the executor they were scheduled with. While any
+// timer is pending the wheel holds work on the context, like a steady_timer
+// would.
+class TimerWheel : public net::execution_context::service
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Duration = Clock::duration;
+    static constexpr Duration tick = std::chrono::milliseconds(1);
+    static constexpr std::size_t slots = 512;
+
+    using key_type = TimerWheel;
+    static inline net::execution_context::id id;
+
+  private:
+    struct Entry
+    {
+        std::function<void()> callback;
+        net::any_io_executor executor;
+        std::size_t rounds{0};
+        std::size_t slot{0};
+        bool linked{false}; // still in wheel[slot]; guarded by the mutex
+        std::atomic<bool> done{false};
+        std::atomic<TimerWheel*> owner{nullptr};
+    };
+
+  public:
+    // Cancelling is safe from any thread. It takes the entry off the wheel
+    // right away, and a callback that was already posted does not run.
+    class Handle
+    {
+        std::shared_ptr<Entry> entry;
+
+      public:
+        Handle() = default;
+        explicit Handle(std::shared_ptr<Entry> e) : entry(std::move(e)) {}
+        void cancel()
+        {
+            if (!entry)
+            {
+                return;
+            }
+            if (!entry->done.exchange(true))
+            {
+                if (auto* owner = entry->owner.load())
+                {
+                    owner->unlink(*entry);
+                }
+            }
+            entry.reset();
+        }
+        bool pending() const
+        {
+            return entry && !entry->done;
+        }
+    };
+
+    explicit TimerWheel(net::execution_context& ctx) :
+        net::execution_context::service(ctx), start(Clock::now()),
+        wheel(slots)
+    {}
+    static TimerWheel& of(const net::any_io_executor& executor)
+    {
+        return net::use_service<TimerWheel>(
+            net::query(executor, net::execution::context));
+    }
+    Handle schedule(Duration delay, net::any_io_executor executor,
+                    std::function<void()> callback)
+    {
+        auto entry = std::make_shared<Entry>();
+        entry->callback = std::move(callback);
+        entry->executor = executor;
+        entry->owner = this;
+        std::lock_guard lock(mutex);
+        if (active == 0)
+        {
+            // Nothing to fire in between: skip the idle ticks rather than
+            // walk them on the next wakeup.
+            current = std::max(current, ticksAt(Clock::now()));
+        }
+        auto ticks = (std::max(delay, Duration::zero()) + tick - Duration(1)) /
+                     tick;
+        auto deadline =
+            std::max(ticksAt(Clock::now()) + static_cast<std::size_t>(ticks),
+                     current);
+        entry->rounds = (deadline - current) / slots;
+        entry->slot = deadline % slots;
+        entry->linked = true;
+        wheel[entry->slot].push_back(entry);
+        ++active;
+        if (!timer)
+        {
+            timer.emplace(std::move(executor));
+        }
+        if (!armed || deadline < armedTick)
+        {
+            arm(deadline);
+        }
+        return Handle(std::move(entry));
+    }
+    std::size_t pending() const
+    {
+        std::lock_guard lock(mutex);
+        return active;
+    }
+
+  private:
+    Clock::time_point start;
+    mutable std::mutex mutex;
+    std::vector<std::vector<std::shared_ptr<Entry>>> wheel;
+    std::optional<net::steady_timer> timer;
+    std::size_t current{0};
+    std::size_t active{0};
+    std::size_t armedTick{0};
+    bool armed{false};
+
+    std::size_t ticksAt(Clock::time_point t) const
+    {
+        return static_cast<std::size_t>((t - start) / tick);
+    }
+    void shutdown() override
+    {
+        std::lock_guard lock(mutex);
+        for (auto& slot : wheel)
+        {
+            for (auto& entry : slot)
+            {
+                entry->owner = nullptr;
+                entry->linked = false;
+            }
+            slot.clear();
+        }
+        active = 0;
+        timer.reset();
+    }
+    // Takes a cancelled entry off the wheel. Once nothing is left the timer
+    // is cancelled, which releases the work it held on the context; if the
+    // entry was all the armed slot held, the timer moves to the next one.
+    void unlink(Entry& entry)
+    {
+        std::lock_guard lock(mutex);
+        if (!entry.linked)
+        {
+            return;
+        }
+        entry.linked = false;
+        std::erase_if(wheel[entry.slot],
+                      [&entry](const auto& e) { return e.get() == &entry; });
+        --active;
+        if (!armed)
+        {
+            return;
+        }
+        if (active == 0)
+        {
+            armed = false;
+            timer->cancel();
+            return;
+        }
+        if (entry.slot == armedTick % slots && wheel[entry.slot].empty())
+        {
+            arm(nextOccupied());
+        }
+    }
+    // Call with the mutex held and at least one entry on the wheel.
+    std::size_t nextOccupied() const
+    {
+        auto next = current;
+        while (wheel[next % slots].empty())
+        {
+            ++next;
+        }
+        return next;
+    }
+    void arm(std::size_t at)
+    {
+        armed = true;
+        armedTick = at;
+        timer->expires_at(start + tick * at);
+        timer->async_wait([this, at](const boost::system::error_code& ec) {
+            if (!ec)
+            {
+                advance(at);
+            }
+        });
+    }
+    void advance(std::size_t at)
+    {
+        std::vector<std::shared_ptr<Entry>> due;
+        {
+            std::lock_guard lock(mutex);
+            if (!armed || armedTick != at)
+            {
+                return;
+            }
+            armed = false;
+            auto now = std::max(ticksAt(Clock::now()), at);
+            for (; current <= now; ++current)
+            {
+                auto& slot = wheel[current % slots];
+                std::erase_if(slot, [&due, this](auto& entry) {
+                    // A cancelled entry may still be here while its
+                    // cancel() waits for the mutex.
+                    if (entry->done || entry->rounds == 0)
+                    {
+                        --active;
+                        entry->linked = false;
+                        if (!entry->done)
+                        {
+                            due.push_back(std::move(entry));
+                        }
+                        return true;
+                    }
+                    --entry->rounds;
+                    return false;
+                });
+            }
+            if (active > 0)
+            {
+                arm(nextOccupied());
+            }
+        }
+        for (auto& entry : due)
+        {
+            auto executor = entry->executor;
+            net::post(executor, [entry = std::move(entry)]() {
+                if (!entry->done.exchange(true))
+                {
+                    entry->callback();
+                }
+            });
+        }
+    }
+};
+} // namespace reactor
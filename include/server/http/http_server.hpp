@@ -193,6 +193,16 @@ struct HttpsServerImpl
     {
         return router_;
     }
+    // Session tickets and session-ID caching; call before listen().
+    HttpsServerImpl& withTlsSessions(TlsServerOptions options)
+    {
+        server.streamMaker.withSessions(std::move(options));
+        return *this;
+    }
+    TlsServerStats tlsStats() const
+    {
+        return server.streamMaker.sessions->stats();
+    }
 };
 using HttpsServer = HttpsServerImpl<SslStreamMaker>;
 using HttpMtlsServer = HttpsServerImpl<MtlsStreamMaker>;
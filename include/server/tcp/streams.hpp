@@ -3,6 +3,7 @@
 #include "common/common_defs.hpp"
 // #include "handle_error.hpp"
 #include "ssl/ssl_utils.hpp"
+#include "ssl/tls_server_sessions.hpp"
 namespace reactor
 {
 inline auto checkFailed(beast::error_code& ec)
@@ -89,8 +90,10 @@ struct SslStreamMakerImpl
         }
     };
     ssl::context sslContext;
+    std::unique_ptr<TlsServerSessions> sessions;
     SslStreamMakerImpl(std::string_view cirtDir,
-                       std::string_view trustStorePath = "") :
+                       std::string_view trustStorePath = "",
+                       TlsServerOptions tlsOptions = {}) :
         sslContext(
             ensuressl::loadCertificate(boost::asio::ssl::context::tls_server,
                                        {cirtDir.data(), cirtDir.size()}))
@@ -101,6 +104,13 @@ struct SslStreamMakerImpl
                 sslContext, trustStorePath.empty() ? ensuressl::trustStorePath
                                                    : trustStorePath);
         }
+        withSessions(std::move(tlsOptions));
+    }
+    // Replaces the resumption settings; only before the server accepts.
+    void withSessions(TlsServerOptions tlsOptions)
+    {
+        sessions = std::make_unique<TlsServerSessions>(std::move(tlsOptions));
+        sessions->apply(sslContext);
     }
 
     void acceptAsyncConnection(net::io_context& ioContext,
@@ -121,8 +131,8 @@ struct SslStreamMakerImpl
         };
         net::spawn(ioContext, std::bind_front(do_accept, do_accept));
     }
-    static void doHandshake(auto work, SSlStreamReader&& reader,
-                            net::yield_context yield)
+    void doHandshake(auto work, SSlStreamReader&& reader,
+                     net::yield_context yield)
     {
         beast::error_code ec{};
         reader.stream().async_handshake(ssl::stream_base::server, yield[ec]);
@@ -130,6 +140,7 @@ struct SslStreamMakerImpl
         {
             return;
         }
+        sessions->handshakeDone(reader.stream().native_handle());
         work(std::move(reader), yield);
     }
 };
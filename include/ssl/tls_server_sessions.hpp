@@ -0,0 +1,370 @@
+#pragma once
+#include "common/common_defs.hpp"
+
+#include <openssl/rand.h>
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+#include <openssl/core_names.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#ifdef SSL_ON
+namespace reactor
+{
+struct TlsServerOptions
+{
+    using Duration = std::chrono::seconds;
+    bool tickets{true};                     // stateless session tickets
+    Duration keyRotation{std::chrono::hours(1)};
+    Duration lifetime{std::chrono::hours(2)}; // of a ticket or cached session
+    bool sharedCache{false}; // session IDs in the process-wide store
+    bool sessionCache{true}; // else, session IDs in the context's own cache
+    std::string sessionIdContext{"reactor"};
+};
+struct TlsServerStats
+{
+    std::size_t full{0};
+    std::size_t resumed{0};
+    std::size_t rotations{0};
+    std::size_t ticketsRejected{0}; // sealed with a key since dropped
+    double resumeRatio() const
+    {
+        auto total = full + resumed;
+        return total == 0 ? 0.0
+                          : static_cast<double>(resumed) /
+                                static_cast<double>(total);
+    }
+};
+
+// Session-ID cache shared by every server context in the process, so a
+// client resumes whichever listener it reconnects to. Sessions are stored
+// serialized; any context with the same session ID context can take them.
+class SharedSessionStore
+{
+    struct Entry
+    {
+        std::string der;
+        std::time_t expires;
+    };
+
+  public:
+    static SharedSessionStore& instance()
+    {
+        static SharedSessionStore store;
+        return store;
+    }
+    SharedSessionStore& withCapacity(std::size_t sessions)
+    {
+        std::lock_guard lock(mutex);
+        capacity = sessions;
+        return *this;
+    }
+    std::size_t size() const
+    {
+        std::lock_guard lock(mutex);
+        return entries.size();
+    }
+    void clear()
+    {
+        std::lock_guard lock(mutex);
+        entries.clear();
+        order.clear();
+    }
+    void attach(SSL_CTX* ctx)
+    {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER |
+                                                SSL_SESS_CACHE_NO_INTERNAL);
+        SSL_CTX_sess_set_new_cb(ctx, &onNew);
+        SSL_CTX_sess_set_get_cb(ctx, &onGet);
+        SSL_CTX_sess_set_remove_cb(ctx, &onRemove);
+    }
+
+  private:
+    mutable std::mutex mutex;
+    std::size_t capacity{20480};
+    std::unordered_map<std::string, Entry> entries;
+    std::deque<std::string> order; // insertion order, for eviction
+
+    static std::string idOf(const SSL_SESSION* session)
+    {
+        unsigned int length = 0;
+        const auto* id = SSL_SESSION_get_id(session, &length);
+        return {reinterpret_cast<const char*>(id), length};
+    }
+    static int onNew(SSL*, SSL_SESSION* session)
+    {
+        auto length = i2d_SSL_SESSION(session, nullptr);
+        if (length <= 0)
+        {
+            return 0;
+        }
+        std::string der(static_cast<std::size_t>(length), '\0');
+        auto* out = reinterpret_cast<unsigned char*>(der.data());
+        i2d_SSL_SESSION(session, &out);
+        auto expires = static_cast<std::time_t>(
+            SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session));
+        instance().put(idOf(session), std::move(der), expires);
+        return 0; // the store kept a copy, not the reference
+    }
+    static SSL_SESSION* onGet(SSL*, const unsigned char* id, int length,
+                              int* copy)
+    {
+        *copy = 0;
+        auto der = instance().get(
+            {reinterpret_cast<const char*>(id),
+             static_cast<std::size_t>(length)});
+        if (der.empty())
+        {
+            return nullptr;
+        }
+        const auto* in = reinterpret_cast<const unsigned char*>(der.data());
+        return d2i_SSL_SESSION(nullptr, &in, static_cast<long>(der.size()));
+    }
+    static void onRemove(SSL_CTX*, SSL_SESSION* session)
+    {
+        auto& store = instance();
+        std::lock_guard lock(store.mutex);
+        store.entries.erase(idOf(session));
+    }
+    void put(std::string id, std::string der, std::time_t expires)
+    {
+        std::lock_guard lock(mutex);
+        while (!order.empty() && entries.size() >= capacity)
+        {
+            entries.erase(order.front());
+            order.pop_front();
+        }
+        if (entries.insert_or_assign(id, Entry{std::move(der), expires})
+                .second)
+        {
+            order.push_back(std::move(id));
+        }
+        // Removed sessions leave their ids in order; keep it bounded.
+        while (order.size() > 2 * capacity)
+        {
+            entries.erase(order.front());
+            order.pop_front();
+        }
+    }
+    std::string get(const std::string& id)
+    {
+        std::lock_guard lock(mutex);
+        auto it = entries.find(id);
+        if (it == entries.end())
+        {
+            return {};
+        }
+        if (it->second.expires <= std::time(nullptr))
+        {
+            entries.erase(it);
+            return {};
+        }
+        return it->second.der;
+    }
+};
+
+// Server side of TLS resumption for one ssl::context: seals session
+// tickets with in-memory keys that rotate every keyRotation, and counts
+// full against resumed handshakes. A key that has been rotated out still
+// opens tickets for one lifetime, and such tickets are renewed under the
+// current key. Keys never leave the process, so a restart forces full
+// handshakes.
+class TlsServerSessions
+{
+    using Clock = std::chrono::steady_clock;
+    struct TicketKey
+    {
+        std::array<unsigned char, 16> name;
+        std::array<unsigned char, 32> aes;
+        std::array<unsigned char, 32> hmac;
+        Clock::time_point created;
+    };
+
+  public:
+    explicit TlsServerSessions(TlsServerOptions tlsOptions = {}) :
+        options(std::move(tlsOptions))
+    {}
+    // Configures ctx to resume through this object. Call before accepting.
+    void apply(ssl::context& ctx)
+    {
+        auto* native = ctx.native_handle();
+        SSL_CTX_set_ex_data(native, index(), this);
+        SSL_CTX_set_session_id_context(
+            native,
+            reinterpret_cast<const unsigned char*>(
+                options.sessionIdContext.data()),
+            static_cast<unsigned int>(std::min<std::size_t>(
+                options.sessionIdContext.size(),
+                SSL_MAX_SID_CTX_LENGTH)));
+        SSL_CTX_set_timeout(native,
+                            static_cast<long>(options.lifetime.count()));
+        if (options.tickets)
+        {
+            SSL_CTX_clear_options(native, SSL_OP_NO_TICKET);
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+            SSL_CTX_set_tlsext_ticket_key_evp_cb(native, &onTicket);
+#else
+            SSL_CTX_set_tlsext_ticket_key_cb(native, &onTicket);
+#endif
+        }
+        else
+        {
+            SSL_CTX_set_options(native, SSL_OP_NO_TICKET);
+        }
+        if (options.sharedCache)
+        {
+            SharedSessionStore::instance().attach(native);
+        }
+        else
+        {
+            SSL_CTX_set_session_cache_mode(native, options.sessionCache
+                                                       ? SSL_SESS_CACHE_SERVER
+                                                       : SSL_SESS_CACHE_OFF);
+        }
+    }
+    // Records a finished server handshake.
+    void handshakeDone(SSL* ssl)
+    {
+        if (SSL_session_reused(ssl) == 1)
+        {
+            resumed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        full.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Starts sealing with a fresh key now rather than at the next rotation.
+    void rotate()
+    {
+        std::lock_guard lock(mutex);
+        addKey(Clock::now());
+    }
+    TlsServerStats stats() const
+    {
+        std::lock_guard lock(mutex);
+        return {full.load(std::memory_order_relaxed),
+                resumed.load(std::memory_order_relaxed), rotations,
+                rejected};
+    }
+
+  private:
+    TlsServerOptions options;
+    mutable std::mutex mutex;
+    std::deque<TicketKey> keys; // newest first
+    std::size_t rotations{0};
+    std::size_t rejected{0};
+    std::atomic<std::size_t> full{0};
+    std::atomic<std::size_t> resumed{0};
+
+    static int index()
+    {
+        static const int slot = SSL_CTX_get_ex_new_index(0, nullptr, nullptr,
+                                                         nullptr, nullptr);
+        return slot;
+    }
+    void addKey(Clock::time_point now)
+    {
+        TicketKey key{};
+        RAND_bytes(key.name.data(), static_cast<int>(key.name.size()));
+        RAND_bytes(key.aes.data(), static_cast<int>(key.aes.size()));
+        RAND_bytes(key.hmac.data(), static_cast<int>(key.hmac.size()));
+        key.created = now;
+        if (!keys.empty())
+        {
+            ++rotations;
+        }
+        keys.push_front(key);
+    }
+    // Rotates when due and drops keys retired for longer than a lifetime.
+    void maintain(Clock::time_point now)
+    {
+        if (keys.empty() || now - keys.front().created >= options.keyRotation)
+        {
+            addKey(now);
+        }
+        // A key retired when its successor was created.
+        while (keys.size() > 1 &&
+               now - keys[keys.size() - 2].created >= options.lifetime)
+        {
+            keys.pop_back();
+        }
+    }
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+    using MacContext = EVP_MAC_CTX;
+    static bool setMacKey(MacContext* mac, const TicketKey& key)
+    {
+        char digest[] = "SHA256";
+        OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_octet_string(
+                OSSL_MAC_PARAM_KEY, const_cast<unsigned char*>(key.hmac.data()),
+                key.hmac.size()),
+            OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+            OSSL_PARAM_construct_end()};
+        return EVP_MAC_CTX_set_params(mac, params) == 1;
+    }
+#else
+    using MacContext = HMAC_CTX;
+    static bool setMacKey(MacContext* mac, const TicketKey& key)
+    {
+        return HMAC_Init_ex(mac, key.hmac.data(),
+                            static_cast<int>(key.hmac.size()), EVP_sha256(),
+                            nullptr) == 1;
+    }
+#endif
+    // 1 seals or opens, 2 opens and asks for a renewed ticket, 0 rejects.
+    static int onTicket(SSL* ssl, unsigned char* name, unsigned char* iv,
+                        EVP_CIPHER_CTX* cipher, MacContext* mac, int encrypt)
+    {
+        auto* self = static_cast<TlsServerSessions*>(
+            SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), index()));
+        if (self == nullptr)
+        {
+            return -1;
+        }
+        std::lock_guard lock(self->mutex);
+        self->maintain(Clock::now());
+        if (encrypt == 1)
+        {
+            const auto& key = self->keys.front();
+            if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1)
+            {
+                return -1;
+            }
+            std::memcpy(name, key.name.data(), key.name.size());
+            if (EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr,
+                                   key.aes.data(), iv) != 1 ||
+                !setMacKey(mac, key))
+            {
+                return -1;
+            }
+            return 1;
+        }
+        auto it = std::ranges::find_if(self->keys, [name](const auto& key) {
+            return std::memcmp(key.name.data(), name, key.name.size()) == 0;
+        });
+        if (it == self->keys.end())
+        {
+            ++self->rejected;
+            return 0;
+        }
+        if (!setMacKey(mac, *it) ||
+            EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr,
+                               it->aes.data(), iv) != 1)
+        {
+            return -1;
+        }
+        // TLS 1.3 clients use a ticket once, so always send a fresh one.
+        return it == self->keys.begin() && SSL_version(ssl) != TLS1_3_VERSION
+                   ? 1
+                   : 2;
+    }
+};
+} // namespace reactor
+#endif
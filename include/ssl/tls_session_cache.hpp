@@ -0,0 +1,214 @@
+#pragma once
+#include "common/common_defs.hpp"
+
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#ifdef SSL_ON
+namespace reactor
+{
+struct TlsSessionOptions
+{
+    std::size_t capacity{256}; // cached origins
+};
+struct TlsSessionStats
+{
+    std::size_t handshakes{0};
+    std::size_t offered{0}; // handshakes that presented a cached session
+    std::size_t resumed{0}; // ...and that the server accepted
+    std::size_t stored{0};
+    double hitRate() const
+    {
+        return handshakes == 0 ? 0.0
+                               : static_cast<double>(resumed) /
+                                     static_cast<double>(handshakes);
+    }
+};
+
+// Process-wide cache of client TLS sessions, keyed by SSL context and origin
+// (host:port). A stream offers the cached session before its handshake so
+// the server can skip the full key exchange. The cache keeps the newest
+// resumable session for each origin: the one in use once a TLS 1.2
+// handshake completes, and each TLS 1.3 ticket as it arrives afterwards.
+class TlsSessionCache
+{
+    struct Key
+    {
+        const SSL_CTX* ctx;
+        std::string origin;
+        bool operator==(const Key&) const = default;
+    };
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const
+        {
+            return std::hash<std::string>{}(key.origin) ^
+                   (std::hash<const void*>{}(key.ctx) << 1);
+        }
+    };
+    struct SessionFree
+    {
+        void operator()(SSL_SESSION* session) const
+        {
+            SSL_SESSION_free(session);
+        }
+    };
+    using Session = std::unique_ptr<SSL_SESSION, SessionFree>;
+
+  public:
+    static TlsSessionCache& instance()
+    {
+        static TlsSessionCache cache;
+        return cache;
+    }
+    TlsSessionCache& withOptions(TlsSessionOptions tlsOptions)
+    {
+        std::lock_guard lock(mutex);
+        options = tlsOptions;
+        return *this;
+    }
+    static std::string originOf(std::string_view host, std::string_view port)
+    {
+        std::string origin(host);
+        origin += ':';
+        origin += port;
+        return origin;
+    }
+    // Call right before the client handshake. origin must outlive the
+    // connection: tickets can arrive long after the handshake.
+    void prepare(SSL* ssl, const std::string& origin)
+    {
+        SSL_set_ex_data(ssl, index(), const_cast<std::string*>(&origin));
+        std::lock_guard lock(mutex);
+        watch(SSL_get_SSL_CTX(ssl));
+        auto it = sessions.find({SSL_get_SSL_CTX(ssl), origin});
+        if (it == sessions.end())
+        {
+            return;
+        }
+        if (expired(it->second.get()))
+        {
+            sessions.erase(it);
+            return;
+        }
+        if (SSL_set_session(ssl, it->second.get()) == 1)
+        {
+            ++counters.offered;
+        }
+    }
+    // Call once the handshake finishes. A failed handshake forgets the
+    // origin's session in case that is what the server choked on.
+    void completed(SSL* ssl, const std::string& origin,
+                   const beast::error_code& ec)
+    {
+        Key key{SSL_get_SSL_CTX(ssl), origin};
+        if (ec)
+        {
+            std::lock_guard lock(mutex);
+            sessions.erase(key);
+            return;
+        }
+        {
+            std::lock_guard lock(mutex);
+            ++counters.handshakes;
+            if (SSL_session_reused(ssl) == 1)
+            {
+                ++counters.resumed;
+            }
+        }
+        store(std::move(key), SSL_get1_session(ssl));
+    }
+    void clear()
+    {
+        std::lock_guard lock(mutex);
+        sessions.clear();
+        counters = {};
+    }
+    TlsSessionStats stats() const
+    {
+        std::lock_guard lock(mutex);
+        return counters;
+    }
+
+  private:
+    mutable std::mutex mutex;
+    TlsSessionOptions options;
+    TlsSessionStats counters;
+    std::unordered_map<Key, Session, KeyHash> sessions;
+
+    static int index()
+    {
+        static const int slot = SSL_get_ex_new_index(0, nullptr, nullptr,
+                                                     nullptr, nullptr);
+        return slot;
+    }
+    static bool expired(const SSL_SESSION* session)
+    {
+        return SSL_SESSION_get_time(session) +
+                   SSL_SESSION_get_timeout(session) <=
+               std::time(nullptr);
+    }
+    // Hooks the context so TLS 1.3 tickets reach the cache when they
+    // arrive; OpenSSL keeps no client sessions of its own.
+    static void watch(SSL_CTX* ctx)
+    {
+        if (SSL_CTX_sess_get_new_cb(ctx) != &onNewSession)
+        {
+            SSL_CTX_set_session_cache_mode(ctx,
+                                           SSL_SESS_CACHE_CLIENT |
+                                               SSL_SESS_CACHE_NO_INTERNAL_STORE);
+            SSL_CTX_sess_set_new_cb(ctx, &onNewSession);
+        }
+    }
+    static int onNewSession(SSL* ssl, SSL_SESSION* session)
+    {
+        auto* origin = static_cast<std::string*>(SSL_get_ex_data(ssl,
+                                                                 index()));
+        if (origin == nullptr)
+        {
+            return 0;
+        }
+        instance().store({SSL_get_SSL_CTX(ssl), *origin}, session);
+        return 1;
+    }
+    // Takes over the reference to session.
+    void store(Key key, SSL_SESSION* raw)
+    {
+        Session session(raw);
+        if (!session)
+        {
+            return;
+        }
+        std::lock_guard lock(mutex);
+        auto it = sessions.find(key);
+        if (SSL_SESSION_is_resumable(session.get()) != 1)
+        {
+            // A TLS 1.3 ticket is spent once used; wait for the next one.
+            if (it != sessions.end() && it->second == session)
+            {
+                sessions.erase(it);
+            }
+            return;
+        }
+        if (it != sessions.end())
+        {
+            if (it->second != session)
+            {
+                it->second = std::move(session);
+                ++counters.stored;
+            }
+            return;
+        }
+        if (sessions.size() >= options.capacity && !sessions.empty())
+        {
+            sessions.erase(sessions.begin());
+        }
+        sessions.emplace(std::move(key), std::move(session));
+        ++counters.stored;
+    }
+};
+} // namespace reactor
+#endif
@@ -0,0 +1,119 @@
+#include "common/dns_cache.hpp"
+
+#include <boost/asio/io_context.hpp>
+
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+using namespace reactor;
+// Names come from /etc/hosts or are pinned with insert(), so nothing here
+// needs a name server.
+TEST(dns, concurrent_lookups_share_one_resolve)
+{
+    net::io_context ioc;
+    auto& cache = DnsCache::instance();
+    cache.clear();
+    std::vector<std::vector<tcp::endpoint>> answers;
+    for (int i = 0; i < 3; ++i)
+    {
+        cache.asyncResolve(ioc.get_executor(), "localhost", "8081",
+                           [&answers](beast::error_code ec, auto endpoints) {
+            EXPECT_FALSE(ec);
+            answers.push_back(std::move(endpoints));
+        });
+    }
+    EXPECT_TRUE(answers.empty());
+    ioc.run();
+
+    ASSERT_EQ(answers.size(), 3);
+    ASSERT_FALSE(answers[0].empty());
+    EXPECT_EQ(answers[0][0].port(), 8081);
+    EXPECT_TRUE(answers[0][0].address().is_loopback());
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.coalesced, 2);
+
+    beast::error_code ec;
+    auto again = cache.resolve(ioc.get_executor(), "localhost", "8081", ec);
+    EXPECT_FALSE(ec);
+    EXPECT_EQ(again.size(), answers[0].size());
+    EXPECT_EQ(cache.stats().hits, 1);
+}
+
+TEST(dns, failures_are_cached_for_the_negative_ttl)
+{
+    net::io_context ioc;
+    auto& cache = DnsCache::instance();
+    cache.clear();
+    cache.withOptions({.negativeTtl = std::chrono::milliseconds(20)});
+    beast::error_code first;
+    beast::error_code second;
+    // An unknown service fails without asking a name server.
+    cache.resolve(ioc.get_executor(), "localhost", "no-such-service", first);
+    cache.resolve(ioc.get_executor(), "localhost", "no-such-service", second);
+    EXPECT_TRUE(first);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(cache.stats().misses, 1);
+    EXPECT_EQ(cache.stats().failures, 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    cache.resolve(ioc.get_executor(), "localhost", "no-such-service", second);
+    EXPECT_EQ(cache.stats().misses, 2);
+    cache.withOptions({});
+}
+
+TEST(dns, hits_rotate_over_the_addresses)
+{
+    net::io_context ioc;
+    auto& cache = DnsCache::instance();
+    cache.clear();
+    DnsCache::Addresses pinned{net::ip::make_address("10.0.0.1"),
+                               net::ip::make_address("10.0.0.2"),
+                               net::ip::make_address("10.0.0.3")};
+    cache.insert("bmc", "443", pinned, 443, std::chrono::minutes(1));
+
+    std::vector<std::string> first;
+    for (int i = 0; i < 4; ++i)
+    {
+        beast::error_code ec;
+        auto endpoints = cache.resolve(ioc.get_executor(), "bmc", "443", ec);
+        ASSERT_EQ(endpoints.size(), 3);
+        first.push_back(endpoints.front().address().to_string());
+    }
+    EXPECT_EQ(first, (std::vector<std::string>{"10.0.0.1", "10.0.0.2",
+                                               "10.0.0.3", "10.0.0.1"}));
+    EXPECT_EQ(cache.stats().misses, 0);
+}
+
+TEST(dns, a_lookup_dropped_with_its_context_releases_the_name)
+{
+    auto& cache = DnsCache::instance();
+    cache.clear();
+    net::io_context ioc;
+    std::optional<beast::error_code> joined;
+    {
+        net::io_context doomed;
+        cache.asyncResolve(doomed.get_executor(), "localhost", "8082",
+                           [](beast::error_code, auto) {});
+        // Joins the lookup running on doomed, which never gets to finish.
+        cache.asyncResolve(ioc.get_executor(), "localhost", "8082",
+                           [&joined](beast::error_code ec, auto) {
+            joined = ec;
+        });
+    }
+    ioc.run();
+    EXPECT_EQ(joined, net::error::operation_aborted);
+
+    std::vector<tcp::endpoint> endpoints;
+    cache.asyncResolve(ioc.get_executor(), "localhost", "8082",
+                       [&endpoints](beast::error_code ec, auto found) {
+        EXPECT_FALSE(ec);
+        endpoints = std::move(found);
+    });
+    ioc.restart();
+    ioc.run();
+    EXPECT_FALSE(endpoints.empty());
+    EXPECT_EQ(cache.stats().misses, 2);
+}
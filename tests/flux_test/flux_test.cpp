@@ -1,54 +1,95 @@
-#include "http/http_client.hpp"
-#include "http/web_client.hpp"
-#include "http_server.hpp"
-
-#include <exec/static_thread_pool.hpp>
-#include <utilities.hpp>
+#include "client/http/http_client.hpp"
+#include "client/http/web_client.hpp"
+#include "common/utilities.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <expected>
 #include <filesystem>
 #include <fstream>
+#include <limits>
 #include <map>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <thread>
 
 #include "gtest/gtest.h"
 using namespace reactor;
 
+// Plain HTTP server on 127.0.0.1:8081 for the connection tests. GET
+// /testget answers "hello"; POST /testpost echoes the request body.
+// Connections are kept alive but closed after a short idle period, so a
+// client's io_context runs dry once its exchanges are done.
 class TestServer
 {
-    exec::static_thread_pool ctx;
-    chai::HttpServer server{"8081"};
-    std::thread* runner{nullptr};
-
-  public:
-    TestServer()
+    using Request = http::request<http::string_body>;
+    struct Connection : std::enable_shared_from_this<Connection>
     {
-        server.router().add_get_handler(
-            "/testget", std::bind_front(&TestServer::testHandler, this));
-        server.router().add_post_handler(
-            "/testpost", std::bind_front(&TestServer::testPostHandler, this));
+        beast::tcp_stream stream;
+        beast::flat_buffer buffer;
+        Request req;
+        http::response<http::string_body> res;
+        explicit Connection(tcp::socket socket) : stream(std::move(socket)) {}
+        void read()
+        {
+            req = {};
+            stream.expires_after(std::chrono::milliseconds(100));
+            http::async_read(stream, buffer, req,
+                             [self = shared_from_this()](beast::error_code ec,
+                                                        std::size_t) {
+                if (!ec)
+                {
+                    self->respond();
+                }
+            });
+        }
+        void respond()
+        {
+            res = {http::status::ok, req.version()};
+            res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+            res.body() = req.method() == http::verb::post ? req.body()
+                                                          : "hello";
+            res.keep_alive(req.keep_alive());
+            res.prepare_payload();
+            http::async_write(stream, res,
+                              [self = shared_from_this()](
+                                  beast::error_code ec, std::size_t) {
+                if (!ec && self->res.keep_alive())
+                {
+                    self->read();
+                }
+            });
+        }
+    };
+    net::io_context ioc;
+    tcp::acceptor acceptor{ioc, {net::ip::make_address("127.0.0.1"), 8081}};
+    std::thread runner;
 
-        runner = new std::thread([&]() { server.start(ctx); });
+    void accept()
+    {
+        acceptor.async_accept([this](beast::error_code ec, tcp::socket socket) {
+            if (ec)
+            {
+                return;
+            }
+            std::make_shared<Connection>(std::move(socket))->read();
+            accept();
+        });
     }
-    ~TestServer() {}
 
-    chai::VariantResponse testHandler(const chai::DynamicbodyRequest& req,
-                                      const chai::http_function& httpfunc)
+  public:
+    TestServer()
     {
-        chai::http::response<chai::http::string_body> res{http::status::ok,
-                                                          req.version()};
-        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-        res.body() = "hello";
-        res.prepare_payload();
-        return res;
+        accept();
+        runner = std::thread([this]() { ioc.run(); });
     }
-    chai::VariantResponse testPostHandler(const chai::DynamicbodyRequest& req,
-                                          const chai::http_function& httpfunc)
+    ~TestServer()
     {
-        chai::http::response<chai::http::string_body> res{http::status::ok,
-                                                          req.version()};
-        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-        res.body() = "hello";
-        res.prepare_payload();
-        return res;
+        ioc.stop();
+        runner.join();
     }
 };
 TestServer server;
@@ -212,7 +253,7 @@ TEST(flux, flux_connection_broadcast_sink)
                 needNext = true;
             return;
         }
-        std::cout << res.error().what() << "\n" << res.response();
+        std::cout << res.error().message() << "\n" << res.response();
     });
 
     m2.subscribe(
@@ -237,7 +278,7 @@ TEST(flux, generator_http_sink)
     auto sink2 = createHttpSink<std::string>(
         AsyncTcpSession<http::string_body>::create(ex));
     int i = 1;
-    sink2.setUrl("http://127.0.0.1:8443/testpost")
+    sink2.setUrl("http://127.0.0.1:8081/testpost")
         .onData([&i](const auto& res, bool& needNext) mutable {
         if (!res.isError())
         {
@@ -249,7 +290,7 @@ TEST(flux, generator_http_sink)
                 needNext = true;
             return;
         }
-        std::cout << res.error().what() << "\n" << res.response();
+        std::cout << res.error().message() << "\n" << res.response();
     });
     m2.subscribe(std::move(sink2));
 
@@ -258,3 +299,1061 @@ TEST(flux, generator_http_sink)
         ioc.run();
     }
 }
+TEST(flux, fused_map_filter)
+{
+    std::vector<std::size_t> captured;
+    auto m2 = Flux<std::string>::range(
+        std::vector<std::string>{"hi", "hello", "hey", "howdy"});
+    m2.fuse()
+        .filter([](const auto& v) { return v.length() > 2; })
+        .map([](const auto& v) { return v.length(); })
+        .map([](auto v) { return v * 2; })
+        .subscribe([&captured](auto v) { captured.push_back(v); });
+    std::vector<std::size_t> expected = {10, 6, 10};
+    EXPECT_EQ(captured, expected);
+}
+TEST(flux, fused_async_subscriber)
+{
+    std::vector<std::size_t> captured;
+    auto m2 = Flux<std::string>::range(
+        std::vector<std::string>{"hi", "hello", "hey", "howdy"});
+    m2.fuse()
+        .filter([](const auto& v) { return v != "hey"; })
+        .map([](const auto& v) {
+        return v.length();
+    }).subscribe([&captured](auto v, auto next) {
+        captured.push_back(v);
+        next(v < 5);
+    });
+    std::vector<std::size_t> expected = {2, 5};
+    EXPECT_EQ(captured, expected);
+}
+TEST(flux, ten_million_generated_values_keep_the_stack_flat)
+{
+    constexpr int total = 10'000'000;
+    auto m2 = Flux<int>::generate([i = 0](bool& hasNext) mutable {
+        hasNext = i + 1 < total;
+        return i++;
+    });
+    int count{0};
+    // Handler frames are measured against a frame that outlives them all.
+    // Were each value delivered from inside the previous one's request, the
+    // distance would grow with every value.
+    char base{};
+    auto baseAddress = reinterpret_cast<std::uintptr_t>(&base);
+    std::uintptr_t nearest = std::numeric_limits<std::uintptr_t>::max();
+    std::uintptr_t farthest = 0;
+    m2.map([](const int& v) { return v + 1; })
+        .filter([](const int& v) { return v % 2 == 0; })
+        .map([](const int& v) { return v / 2; })
+        .subscribe([&](const int& v) {
+        char marker{};
+        auto address = reinterpret_cast<std::uintptr_t>(&marker);
+        auto distance = baseAddress > address ? baseAddress - address
+                                              : address - baseAddress;
+        nearest = std::min(nearest, distance);
+        farthest = std::max(farthest, distance);
+        count++;
+    });
+    EXPECT_EQ(count, total / 2);
+    EXPECT_LT(farthest - nearest, 4096);
+}
+TEST(flux, request_n_prefetch)
+{
+    auto m2 = Flux<int>::generate([i = 0](bool& hasNext) mutable {
+        hasNext = i < 9;
+        return i++;
+    });
+    std::vector<int> captured;
+    m2.subscribe([&captured](int v, auto next) {
+        captured.push_back(v);
+        // Ask for three more up front and nothing after that.
+        if (v == 0)
+        {
+            next.request(3);
+        }
+    });
+    std::vector<int> expected = {0, 1, 2, 3};
+    EXPECT_EQ(captured, expected);
+}
+TEST(flux, request_n_cancel)
+{
+    bool finished{false};
+    auto m2 = Flux<int>::generate([i = 0](bool& hasNext) mutable {
+        hasNext = i < 100;
+        return i++;
+    });
+    std::vector<int> captured;
+    m2.onFinish([&finished]() { finished = true; })
+        .subscribe([&captured](int v, auto next) {
+        captured.push_back(v);
+        if (v == 0)
+        {
+            next.request(50);
+        }
+        if (v == 5)
+        {
+            next.cancel();
+        }
+    });
+    std::vector<int> expected = {0, 1, 2, 3, 4, 5};
+    EXPECT_EQ(captured, expected);
+    EXPECT_EQ(finished, false);
+}
+TEST(flux, publish_on_thread_pool_keeps_order)
+{
+    net::thread_pool pool(4);
+    auto callerId = std::this_thread::get_id();
+    std::vector<int> captured;
+    bool offCaller{true};
+    std::optional<std::size_t> finishedAfter;
+    auto m2 = Flux<int>::generate([i = 0](bool& hasNext) mutable {
+        hasNext = i < 999;
+        return i++;
+    });
+    m2.onFinish([&]() { finishedAfter = captured.size(); });
+    m2.publishOn(pool).map([](auto v) { return v * 2; }).subscribe(
+        [&](int v) {
+        offCaller = offCaller && std::this_thread::get_id() != callerId;
+        captured.push_back(v);
+    });
+    pool.join();
+    std::vector<int> expected(1000);
+    std::ranges::generate(expected, [i = 0]() mutable { return 2 * i++; });
+    EXPECT_EQ(captured, expected);
+    EXPECT_EQ(offCaller, true);
+    // The generator is done long before the queue is; completion waits.
+    EXPECT_EQ(finishedAfter, 1000);
+}
+TEST(flux, publish_on_bounds_prefetch)
+{
+    net::thread_pool pool(2);
+    std::atomic<int> generated{0};
+    std::vector<int> captured;
+    auto m2 = Flux<int>::generate([&generated](bool& hasNext) {
+        hasNext = true;
+        return generated++;
+    });
+    m2.publishOn(pool, 4).subscribe([&captured](int v, auto next) {
+        captured.push_back(v);
+        if (v < 9)
+        {
+            next(true);
+        }
+    });
+    pool.join();
+    EXPECT_EQ(captured.size(), 10);
+    EXPECT_LE(generated, 10 + 4);
+}
+TEST(flux, subscribe_on_strand)
+{
+    net::thread_pool pool(2);
+    auto strand = net::make_strand(pool);
+    std::vector<int> captured;
+    bool onStrand{true};
+    auto m2 = Flux<int>::range(std::vector<int>{1, 2, 3, 4});
+    m2.subscribeOn(strand).subscribe([&](int v) {
+        onStrand = onStrand && strand.running_in_this_thread();
+        captured.push_back(v);
+    });
+    pool.join();
+    std::vector<int> expected = {1, 2, 3, 4};
+    EXPECT_EQ(captured, expected);
+    EXPECT_EQ(onStrand, true);
+}
+TEST(flux, parallel_ordered_keeps_order)
+{
+    net::thread_pool pool(4);
+    std::vector<int> captured;
+    auto m2 = Flux<int>::generate([i = 0](bool& hasNext) mutable {
+        hasNext = i < 999;
+        return i++;
+    });
+    m2.parallel(4)
+        .runOn(pool)
+        .filter([](auto v) { return v % 3 != 0; })
+        .map([](auto v) { return std::to_string(v); })
+        .ordered()
+        .subscribe([&captured](const std::string& v) {
+        captured.push_back(std::stoi(v));
+    });
+    pool.join();
+    std::vector<int> expected;
+    for (int i = 0; i < 1000; ++i)
+    {
+        if (i % 3 != 0)
+        {
+            expected.push_back(i);
+        }
+    }
+    EXPECT_EQ(captured, expected);
+}
+TEST(flux, parallel_sequential_merges_all_rails)
+{
+    net::thread_pool pool(4);
+    std::vector<int> captured;
+    std::mutex threadsLock;
+    std::set<std::thread::id> threads;
+    std::atomic<int> meeting{0};
+    std::optional<std::size_t> finishedAfter;
+    auto m2 = Flux<int>::generate([i = 0](bool& hasNext) mutable {
+        hasNext = i < 9999;
+        return i++;
+    });
+    m2.onFinish([&]() { finishedAfter = captured.size(); });
+    m2.parallel(4)
+        .runOn(pool)
+        .map([&](auto v) {
+        {
+            std::lock_guard guard(threadsLock);
+            threads.insert(std::this_thread::get_id());
+        }
+        // The first two values sit on different rails; each waits for the
+        // other, which only arrives if the rails run side by side.
+        if (v < 2)
+        {
+            ++meeting;
+            auto giveUp = std::chrono::steady_clock::now() +
+                          std::chrono::seconds(5);
+            while (meeting < 2 && std::chrono::steady_clock::now() < giveUp)
+            {
+                std::this_thread::yield();
+            }
+        }
+        return v * 2;
+    })
+        .sequential()
+        .subscribe([&captured](int v) { captured.push_back(v); });
+    pool.join();
+    std::ranges::sort(captured);
+    std::vector<int> expected(10000);
+    std::ranges::generate(expected, [i = 0]() mutable { return 2 * i++; });
+    EXPECT_EQ(captured, expected);
+    EXPECT_GE(threads.size(), 2);
+    EXPECT_EQ(finishedAfter, 10000);
+}
+// Emits its value from the io_context instead of inline, like an HttpMono.
+struct DeferredInt : Mono<int>::SourceHandler
+{
+    net::io_context& ioc;
+    int value;
+    bool pending{true};
+    DeferredInt(net::io_context& ctx, int v) : ioc(ctx), value(v) {}
+    void next(std::function<void(int)> consumer) override
+    {
+        pending = false;
+        net::post(ioc, [consumer = std::move(consumer), v = value]() {
+            consumer(v);
+        });
+    }
+    bool hasNext() const override
+    {
+        return pending;
+    }
+};
+TEST(flux, flat_map_bounds_concurrency)
+{
+    net::io_context ioc;
+    int started{0};
+    int delivered{0};
+    int maxActive{0};
+    std::vector<int> captured;
+    std::vector<int> input(20);
+    std::iota(input.begin(), input.end(), 0);
+    auto m2 = Flux<int>::range(std::move(input));
+    m2.flatMap(
+          [&](int v) {
+        maxActive = std::max(maxActive, ++started - delivered);
+        return std::make_shared<Mono<int>>(new DeferredInt(ioc, v * 10));
+    },
+          3)
+        .subscribe([&](int v) {
+        ++delivered;
+        captured.push_back(v);
+    });
+    ioc.run();
+    std::ranges::sort(captured);
+    std::vector<int> expected(20);
+    std::ranges::generate(expected, [i = 0]() mutable { return 10 * i++; });
+    EXPECT_EQ(captured, expected);
+    EXPECT_EQ(maxActive, 3);
+}
+TEST(flux, concat_map_keeps_order)
+{
+    std::vector<int> captured;
+    auto m2 = Flux<int>::range(std::vector<int>{1, 2, 3});
+    m2.concatMap([](int v) {
+        return Flux<int>::range(std::vector<int>{v, v * 10});
+    }).subscribe([&captured](int v) { captured.push_back(v); });
+    std::vector<int> expected = {1, 10, 2, 20, 3, 30};
+    EXPECT_EQ(captured, expected);
+}
+TEST(flux, zip_pairs_values)
+{
+    std::vector<std::tuple<int, std::string>> captured;
+    auto m2 = zip(Flux<int>::range(std::vector<int>{1, 2, 3}),
+                  Flux<std::string>::range(std::vector<std::string>{"a", "b"}));
+    bool finished{false};
+    m2.onFinish([&finished]() { finished = true; })
+        .subscribe([&captured](const auto& v) { captured.push_back(v); });
+    std::vector<std::tuple<int, std::string>> expected = {{1, "a"}, {2, "b"}};
+    EXPECT_EQ(captured, expected);
+    EXPECT_EQ(finished, true);
+}
+TEST(flux, merge_and_concat)
+{
+    std::vector<int> merged;
+    auto m2 = merge(Flux<int>::range(std::vector<int>{1, 2}),
+                    Mono<int>::just(3));
+    m2.subscribe([&merged](int v) { merged.push_back(v); });
+    std::ranges::sort(merged);
+    EXPECT_EQ(merged, (std::vector<int>{1, 2, 3}));
+
+    std::vector<int> concatenated;
+    auto m3 = concat(Flux<int>::range(std::vector<int>{1, 2}),
+                     Mono<int>::just(3),
+                     Flux<int>::range(std::vector<int>{4}));
+    m3.subscribe([&concatenated](int v) { concatenated.push_back(v); });
+    EXPECT_EQ(concatenated, (std::vector<int>{1, 2, 3, 4}));
+}
+TEST(flux, combine_latest_async)
+{
+    net::io_context ioc;
+    std::vector<std::tuple<int, int>> captured;
+    auto deferred = std::make_shared<Mono<int>>(new DeferredInt(ioc, 1));
+    auto m2 = combineLatest(deferred,
+                            Flux<int>::range(std::vector<int>{10, 20}));
+    m2.subscribe([&captured](const auto& v) { captured.push_back(v); });
+    ioc.run();
+    ASSERT_FALSE(captured.empty());
+    EXPECT_EQ(captured.back(), std::make_tuple(1, 20));
+}
+TEST(flux, co_await_loop_pulls_on_demand)
+{
+    net::io_context ioc;
+    int generated{0};
+    auto m2 = Flux<int>::generate([&generated](bool& hasNext) {
+        hasNext = generated < 4;
+        return generated++;
+    });
+    std::vector<std::pair<int, int>> captured;
+    net::co_spawn(
+        ioc,
+        [&]() -> net::awaitable<void> {
+        while (auto v = co_await m2.asyncNext(net::use_awaitable))
+        {
+            captured.emplace_back(*v, generated);
+        }
+    },
+        net::detached);
+    ioc.run();
+    std::vector<std::pair<int, int>> expected = {
+        {0, 1}, {1, 2}, {2, 3}, {3, 4}, {4, 5}};
+    EXPECT_EQ(captured, expected);
+}
+TEST(flux, decoupled_sinks_slow_sink_falls_behind)
+{
+    std::vector<int> fast;
+    std::vector<int> slow;
+    std::function<void(bool)> slowDone;
+    auto fastSink = [&fast](const int& v, auto&& done) {
+        fast.push_back(v);
+        done(true);
+    };
+    auto slowSink = [&](const int& v, auto&& done) {
+        slow.push_back(v);
+        slowDone = done;
+    };
+    auto group = createDecoupledSinkGroup<int>(
+        makeLane(fastSink), makeLane(slowSink, {.capacity = 4}));
+    std::vector<int> input(100);
+    std::iota(input.begin(), input.end(), 0);
+    auto m2 = Flux<int>::range(std::move(input));
+    m2.subscribe(group);
+    EXPECT_EQ(fast.size(), 100);
+    EXPECT_EQ(group.laneStats(1).lag, 4);
+    EXPECT_EQ(group.laneStats(1).dropped, 95);
+    while (slow.size() < 5)
+    {
+        std::exchange(slowDone, nullptr)(true);
+    }
+    std::vector<int> expected = {0, 96, 97, 98, 99};
+    EXPECT_EQ(slow, expected);
+}
+TEST(flux, decoupled_sinks_block_holds_upstream)
+{
+    std::vector<int> fast;
+    std::function<void(bool)> slowDone;
+    auto fastSink = [&fast](const int& v, auto&& done) {
+        fast.push_back(v);
+        done(true);
+    };
+    auto slowSink = [&slowDone](const int&, auto&& done) { slowDone = done; };
+    auto group = createDecoupledSinkGroup<int>(
+        makeLane(fastSink),
+        makeLane(slowSink,
+                 {.capacity = 2, .policy = OverflowPolicy::Block}));
+    std::vector<int> input(10);
+    std::iota(input.begin(), input.end(), 0);
+    auto m2 = Flux<int>::range(std::move(input));
+    m2.subscribe(group);
+    EXPECT_EQ(fast.size(), 3);
+    std::exchange(slowDone, nullptr)(true);
+    EXPECT_EQ(fast.size(), 4);
+    EXPECT_EQ(group.laneStats(1).dropped, 0);
+}
+TEST(flux, decoupled_sinks_spill_keeps_everything)
+{
+    std::vector<int> slow;
+    std::function<void(bool)> slowDone;
+    auto slowSink = [&](const int& v, auto&& done) {
+        slow.push_back(v);
+        slowDone = done;
+    };
+    auto group = createDecoupledSinkGroup<int>(makeLane(
+        slowSink, {.capacity = 2, .policy = OverflowPolicy::Spill}));
+    std::vector<int> input(20);
+    std::iota(input.begin(), input.end(), 0);
+    auto m2 = Flux<int>::range(input);
+    m2.subscribe(group);
+    EXPECT_EQ(group.laneStats(0).spilled, 17);
+    while (slow.size() < 20)
+    {
+        std::exchange(slowDone, nullptr)(true);
+    }
+    EXPECT_EQ(slow, input);
+}
+TEST(flux, large_payloads_move_through_fused_stages)
+{
+    struct Counted
+    {
+        std::string data;
+        int* copies;
+        Counted(std::string d, int* c) : data(std::move(d)), copies(c) {}
+        Counted(const Counted& o) : data(o.data), copies(o.copies)
+        {
+            ++*copies;
+        }
+        Counted(Counted&&) = default;
+    };
+    int copies = 0;
+    std::vector<Counted> input;
+    std::vector<const char*> origins;
+    for (int i = 0; i < 4; ++i)
+    {
+        input.emplace_back(std::string(1 << 20, 'a' + i), &copies);
+        origins.push_back(input.back().data.data());
+    }
+    std::vector<const char*> seen;
+    auto flux = Flux<Counted>::range(std::move(input));
+    flux.fuse()
+        .map([](Counted&& c) { return std::move(c); })
+        .filter([](const Counted& c) { return !c.data.empty(); })
+        .subscribe([&seen](Counted&& c, auto&& reqNext) {
+        seen.push_back(c.data.data());
+        reqNext(true);
+    });
+    EXPECT_EQ(copies, 0);
+    EXPECT_EQ(seen, origins);
+}
+TEST(flux, interval_ticks_until_cancelled)
+{
+    net::io_context ioc;
+    std::vector<int> ticks;
+    auto begin = std::chrono::steady_clock::now();
+    auto flux = Flux<int>::interval(ioc.get_executor(),
+                                    std::chrono::milliseconds(5));
+    flux.subscribe([&ticks](int v, auto&& reqNext) {
+        ticks.push_back(v);
+        if (ticks.size() < 3)
+        {
+            reqNext(true);
+            return;
+        }
+        reqNext.cancel();
+    });
+    ioc.run();
+    EXPECT_EQ(ticks, (std::vector<int>{0, 1, 2}));
+    EXPECT_GE(std::chrono::steady_clock::now() - begin,
+              std::chrono::milliseconds(15));
+}
+TEST(flux, delay_elements_keeps_order)
+{
+    net::io_context ioc;
+    std::vector<int> seen;
+    auto begin = std::chrono::steady_clock::now();
+    auto flux = Flux<int>::range(std::vector<int>{1, 2, 3});
+    flux.delayElements(ioc.get_executor(), std::chrono::milliseconds(10))
+        .subscribe([&seen](int v) { seen.push_back(v); });
+    EXPECT_TRUE(seen.empty());
+    ioc.run();
+    EXPECT_EQ(seen, (std::vector<int>{1, 2, 3}));
+    EXPECT_GE(std::chrono::steady_clock::now() - begin,
+              std::chrono::milliseconds(30));
+}
+TEST(flux, buffer_timeout_by_size_time_and_finish)
+{
+    net::io_context ioc;
+    std::vector<std::vector<int>> batches;
+    auto flux = Flux<int>::interval(ioc.get_executor(),
+                                    std::chrono::milliseconds(1));
+    flux.bufferTimeout(ioc.get_executor(), 4, std::chrono::seconds(5))
+        .subscribe([&batches](std::vector<int> v, auto&& reqNext) {
+        batches.push_back(std::move(v));
+        batches.size() < 2 ? reqNext(true) : reqNext.cancel();
+    });
+    auto started = std::chrono::steady_clock::now();
+    ioc.run();
+    EXPECT_EQ(batches, (std::vector<std::vector<int>>{{0, 1, 2, 3},
+                                                      {4, 5, 6, 7}}));
+    // The cancelled 5 s batch timer leaves the wheel instead of holding
+    // the context until it expires.
+    EXPECT_LT(std::chrono::steady_clock::now() - started,
+              std::chrono::seconds(1));
+
+    batches.clear();
+    auto slow = Flux<int>::interval(ioc.get_executor(),
+                                    std::chrono::milliseconds(20));
+    slow.bufferTimeout(ioc.get_executor(), 100, std::chrono::milliseconds(5))
+        .subscribe([&batches](std::vector<int> v, auto&& reqNext) {
+        batches.push_back(std::move(v));
+        batches.size() < 2 ? reqNext(true) : reqNext.cancel();
+    });
+    ioc.restart();
+    ioc.run();
+    EXPECT_EQ(batches, (std::vector<std::vector<int>>{{0}, {1}}));
+
+    batches.clear();
+    auto finite = Flux<int>::range(std::vector<int>{1, 2, 3, 4, 5});
+    finite.bufferTimeout(ioc.get_executor(), 2, std::chrono::seconds(5))
+        .subscribe([&batches](std::vector<int> v) {
+        batches.push_back(std::move(v));
+    });
+    EXPECT_EQ(batches, (std::vector<std::vector<int>>{{1, 2}, {3, 4}, {5}}));
+}
+TEST(flux, debounce_and_sample_keep_latest)
+{
+    net::io_context ioc;
+    std::vector<int> debounced;
+    auto burst = Flux<int>::range(std::vector<int>{1, 2, 3});
+    burst.debounce(ioc.get_executor(), std::chrono::milliseconds(10))
+        .subscribe([&debounced](int v) { debounced.push_back(v); });
+    EXPECT_EQ(debounced, std::vector<int>{3});
+
+    std::vector<int> sampled;
+    auto ticks = Flux<int>::interval(ioc.get_executor(),
+                                     std::chrono::milliseconds(2));
+    ticks.sample(ioc.get_executor(), std::chrono::milliseconds(20))
+        .subscribe([&sampled](int v, auto&& reqNext) {
+        sampled.push_back(v);
+        sampled.size() < 2 ? reqNext(true) : reqNext.cancel();
+    });
+    ioc.run();
+    ASSERT_EQ(sampled.size(), 2);
+    EXPECT_GT(sampled[1], sampled[0] + 1);
+}
+TEST(flux, timeout_cancels_silent_upstream)
+{
+    net::io_context ioc;
+    bool timedOut = false;
+    int values = 0;
+    auto flux = Flux<int>::interval(ioc.get_executor(),
+                                    std::chrono::milliseconds(50));
+    flux.onError([&timedOut](const beast::error_code& ec) {
+        timedOut = ec == beast::error::timeout;
+    });
+    flux.timeout(ioc.get_executor(), std::chrono::milliseconds(10))
+        .subscribe([&values](int) { ++values; });
+    ioc.run();
+    EXPECT_TRUE(timedOut);
+    EXPECT_EQ(values, 0);
+}
+TEST(flux, buffer_hands_out_reused_spans)
+{
+    std::vector<std::vector<int>> batches;
+    std::set<const int*> storage;
+    auto flux = Flux<int>::range(std::vector<int>{1, 2, 3, 4, 5, 6, 7});
+    flux.buffer(3).subscribe([&](std::span<const int> batch) {
+        batches.emplace_back(batch.begin(), batch.end());
+        storage.insert(batch.data());
+    });
+    EXPECT_EQ(batches,
+              (std::vector<std::vector<int>>{{1, 2, 3}, {4, 5, 6}, {7}}));
+    EXPECT_EQ(storage.size(), 1);
+
+    batches.clear();
+    auto lines = Flux<int>::range(std::vector<int>{1, 0, 2, 3, 0, 4});
+    lines.bufferUntil([](int v) { return v == 0; })
+        .subscribe([&batches](std::span<const int> batch, auto&& reqNext) {
+        batches.emplace_back(batch.begin(), batch.end());
+        reqNext(true);
+    });
+    EXPECT_EQ(batches,
+              (std::vector<std::vector<int>>{{1, 0}, {2, 3, 0}, {4}}));
+}
+TEST(flux, window_slides_over_values)
+{
+    std::vector<std::vector<int>> windows;
+    auto flux = Flux<int>::range(std::vector<int>{1, 2, 3, 4, 5, 6});
+    flux.window(3).subscribe([&windows](std::span<const int> w) {
+        windows.emplace_back(w.begin(), w.end());
+    });
+    EXPECT_EQ(windows, (std::vector<std::vector<int>>{
+                           {1, 2, 3}, {2, 3, 4}, {3, 4, 5}, {4, 5, 6}}));
+
+    windows.clear();
+    auto stepped = Flux<int>::range(std::vector<int>{1, 2, 3, 4, 5, 6, 7});
+    stepped.window(3, 2).subscribe([&windows](std::span<const int> w) {
+        windows.emplace_back(w.begin(), w.end());
+    });
+    EXPECT_EQ(windows, (std::vector<std::vector<int>>{
+                           {1, 2, 3}, {3, 4, 5}, {5, 6, 7}}));
+
+    windows.clear();
+    auto shortFlux = Flux<int>::range(std::vector<int>{1, 2});
+    shortFlux.window(3).subscribe([&windows](std::span<const int> w) {
+        windows.emplace_back(w.begin(), w.end());
+    });
+    EXPECT_EQ(windows, (std::vector<std::vector<int>>{{1, 2}}));
+}
+TEST(flux, buffer_and_window_serve_requested_demand)
+{
+    std::vector<std::vector<int>> batches;
+    auto flux = Flux<int>::range(std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8, 9});
+    flux.buffer(2).subscribe(
+        [&batches](std::span<const int> batch, auto&& reqNext) {
+        batches.emplace_back(batch.begin(), batch.end());
+        if (batches.size() == 1)
+        {
+            reqNext.request(2);
+        }
+    });
+    EXPECT_EQ(batches,
+              (std::vector<std::vector<int>>{{1, 2}, {3, 4}, {5, 6}}));
+
+    std::vector<std::vector<int>> windows;
+    auto slid = Flux<int>::range(std::vector<int>{1, 2, 3, 4, 5, 6});
+    slid.window(2).subscribe(
+        [&windows](std::span<const int> w, auto&& reqNext) {
+        windows.emplace_back(w.begin(), w.end());
+        if (windows.size() == 1)
+        {
+            reqNext.request(3);
+        }
+    });
+    EXPECT_EQ(windows, (std::vector<std::vector<int>>{
+                           {1, 2}, {2, 3}, {3, 4}, {4, 5}}));
+}
+TEST(flux, publish_subscribes_upstream_once)
+{
+    int pulls = 0;
+    auto source = Flux<int>::generate([&pulls](bool& next) {
+        next = pulls < 4;
+        return ++pulls;
+    });
+    auto hub = source.publish();
+    std::vector<int> first;
+    std::vector<int> second;
+    auto a = hub->asFlux();
+    auto b = hub->asFlux();
+    a.subscribe([&first](int v) { first.push_back(v); });
+    b.subscribe([&second](int v) { second.push_back(v); });
+    EXPECT_TRUE(first.empty());
+    hub->connect();
+    EXPECT_EQ(pulls, 5);
+    EXPECT_EQ(first, (std::vector<int>{1, 2, 3, 4, 5}));
+    EXPECT_EQ(second, first);
+}
+TEST(flux, shared_upstream_waits_for_slowest_subscriber)
+{
+    auto source = Flux<int>::range(std::vector<int>{1, 2, 3, 4, 5, 6});
+    auto hub = source.share(2);
+    std::vector<int> fast;
+    std::vector<int> slow;
+    CompletionToken slowNext;
+    auto a = hub->asFlux();
+    auto b = hub->asFlux();
+    b.subscribe([&slow, &slowNext](int v, auto&& reqNext) {
+        slow.push_back(v);
+        slowNext = reqNext;
+    });
+    a.subscribe([&fast](int v) { fast.push_back(v); });
+    // The ring holds 2 and 3 for the slow subscriber, which has taken 1.
+    EXPECT_EQ(slow, std::vector<int>{1});
+    EXPECT_EQ(fast, (std::vector<int>{1, 2, 3}));
+    while (slow.size() < 6)
+    {
+        std::exchange(slowNext, CompletionToken{})(true);
+    }
+    EXPECT_EQ(fast, slow);
+}
+TEST(flux, replay_serves_late_subscribers_from_history)
+{
+    auto source = Flux<int>::range(std::vector<int>{1, 2, 3, 4, 5});
+    auto hub = source.replay(3);
+    hub->connect();
+    std::vector<int> late;
+    bool finished = false;
+    auto a = hub->asFlux();
+    a.onFinish([&finished]() { finished = true; }).subscribe([&late](int v) {
+        late.push_back(v);
+    });
+    EXPECT_EQ(late, (std::vector<int>{3, 4, 5}));
+    EXPECT_TRUE(finished);
+}
+TEST(flux, replay_of_a_full_ring_keeps_late_subscribers_in_bounds)
+{
+    net::io_context ioc;
+    // The interval holds no work while the hub has paused it.
+    auto work = net::make_work_guard(ioc);
+    auto source =
+        Flux<int>::interval(ioc.get_executor(), std::chrono::milliseconds(1));
+    // History as large as the ring: a late subscriber starts at its oldest
+    // value, which the next push evicts.
+    auto hub = source.replay(2, 2);
+    std::vector<int> early;
+    std::vector<int> late;
+    auto a = hub->asFlux();
+    a.subscribe([&early](int v) { early.push_back(v); });
+    hub->connect();
+    while (early.size() < 3)
+    {
+        ioc.run_one();
+    }
+    auto b = hub->asFlux();
+    while (early.size() < 4)
+    {
+        ioc.run_one();
+    }
+    b.subscribe([&late](int v) { late.push_back(v); });
+    while (late.size() < 4)
+    {
+        ioc.run_one();
+    }
+    EXPECT_EQ(late, (std::vector<int>{early[2], early[3], early[3] + 1,
+                                      early[3] + 2}));
+}
+TEST(flux, dispose_stops_generator_and_releases_stages)
+{
+    int next = 0;
+    auto flux = Flux<int>::generate([&next](bool&) { return next++; });
+    auto captured = std::make_shared<int>(10);
+    std::vector<int> seen;
+    CompletionToken pending;
+    auto disposable =
+        flux.map([captured](int v) { return v * *captured; })
+            .subscribe([&seen, &pending](int v, auto&& reqNext) {
+        seen.push_back(v);
+        pending = reqNext;
+    });
+    std::exchange(pending, CompletionToken{})(true);
+    EXPECT_EQ(captured.use_count(), 2);
+    disposable.dispose();
+    // A token handed out before the dispose no longer pulls.
+    std::exchange(pending, CompletionToken{})(true);
+    EXPECT_EQ(seen, (std::vector<int>{0, 10}));
+    EXPECT_EQ(captured.use_count(), 1);
+    EXPECT_TRUE(disposable.disposed());
+}
+TEST(flux, dispose_frees_a_shared_pipeline_from_inside_its_handler)
+{
+    net::io_context ioc;
+    auto resource = std::make_shared<int>(0);
+    auto flux = std::make_shared<Flux<int>>(
+        Flux<int>::interval(ioc.get_executor(), std::chrono::milliseconds(2)));
+    std::weak_ptr<Flux<int>> watch = flux;
+    Disposable disposable;
+    // The handler keeps its own root alive, which used to leak it.
+    disposable = flux->subscribe(
+        [resource, flux, &disposable](int v, auto&& reqNext) {
+        *resource = v;
+        if (v == 2)
+        {
+            disposable.dispose();
+        }
+        reqNext(true);
+    });
+    flux.reset();
+    ioc.run();
+    EXPECT_EQ(*resource, 2);
+    EXPECT_TRUE(watch.expired());
+    EXPECT_EQ(resource.use_count(), 1);
+}
+TEST(flux, dispose_cancels_the_timers_of_timed_stages)
+{
+    net::io_context ioc;
+    std::vector<int> seen;
+    auto delayed = std::make_shared<Flux<int>>(
+        Flux<int>::range(std::vector<int>{1, 2, 3}));
+    auto delaying = delayed->delayElements(ioc.get_executor(),
+                                           std::chrono::seconds(5))
+                        .subscribe([&seen](int v) { seen.push_back(v); });
+    auto ticking = std::make_shared<Flux<int>>(
+        Flux<int>::interval(ioc.get_executor(), std::chrono::seconds(5)));
+    auto watching = ticking->timeout(ioc.get_executor(), std::chrono::seconds(5))
+                        .subscribe([&seen](int v) { seen.push_back(v); });
+    delaying.dispose();
+    watching.dispose();
+    delayed.reset();
+    ticking.reset();
+    // Nothing is left on the wheel to fire into the freed stages, or to
+    // hold the context until it is due.
+    auto started = std::chrono::steady_clock::now();
+    ioc.run();
+    EXPECT_LT(std::chrono::steady_clock::now() - started,
+              std::chrono::seconds(1));
+    EXPECT_TRUE(seen.empty());
+}
+auto failOn(int bad)
+{
+    return [bad](int v) -> std::expected<int, beast::error_code> {
+        if (v == bad)
+        {
+            return std::unexpected(
+                beast::error_code(net::error::connection_refused));
+        }
+        return v * 10;
+    };
+}
+TEST(flux, try_map_error_fails_the_flux)
+{
+    auto flux = Flux<int>::range(std::vector<int>{1, 2, 3, 4});
+    std::vector<int> seen;
+    beast::error_code failed;
+    bool finished = false;
+    flux.onFinish([&finished]() { finished = true; })
+        .onError([&failed](const beast::error_code& ec) { failed = ec; });
+    flux.tryMap(failOn(3)).subscribe([&seen](int v) { seen.push_back(v); });
+    EXPECT_EQ(seen, (std::vector<int>{10, 20}));
+    EXPECT_EQ(failed, net::error::connection_refused);
+    EXPECT_FALSE(finished);
+}
+TEST(flux, on_error_return_and_resume_replace_the_failure)
+{
+    auto a = Flux<int>::range(std::vector<int>{1, 2, 3});
+    std::vector<int> returned;
+    bool finished = false;
+    a.onFinish([&finished]() { finished = true; });
+    a.tryMap(failOn(2)).onErrorReturn(-1).subscribe(
+        [&returned](int v) { returned.push_back(v); });
+    EXPECT_EQ(returned, (std::vector<int>{10, -1}));
+    EXPECT_TRUE(finished);
+
+    auto b = Flux<int>::range(std::vector<int>{1, 2, 3});
+    std::vector<int> resumed;
+    beast::error_code observed;
+    finished = false;
+    b.onFinish([&finished]() { finished = true; });
+    b.tryMap(failOn(2))
+        .doOnError([&observed](const beast::error_code& ec) { observed = ec; })
+        .onErrorResume([](const beast::error_code&) {
+        return Flux<int>::range(std::vector<int>{7, 8});
+    }).subscribe([&resumed](int v) { resumed.push_back(v); });
+    EXPECT_EQ(resumed, (std::vector<int>{10, 7, 8}));
+    EXPECT_EQ(observed, net::error::connection_refused);
+    EXPECT_TRUE(finished);
+}
+struct FlakySource : Flux<int>::SourceHandler
+{
+    int failures;
+    int produced{0};
+    explicit FlakySource(int f) : failures(f) {}
+    void next(std::function<void(int)> consumer) override
+    {
+        if (failures > 0)
+        {
+            --failures;
+            fail(net::error::connection_reset);
+            return;
+        }
+        consumer(produced++);
+    }
+    bool hasNext() const override
+    {
+        return produced < 3;
+    }
+};
+TEST(flux, on_error_resume_keeps_the_fallback_handlers)
+{
+    auto fallback = std::make_shared<Flux<int>>(
+        Flux<int>::range(std::vector<int>{7, 8}));
+    bool fallbackFinished = false;
+    fallback->onFinish([&fallbackFinished]() { fallbackFinished = true; });
+    auto flux = Flux<int>::range(std::vector<int>{1, 2});
+    bool finished = false;
+    flux.onFinish([&finished]() { finished = true; });
+    std::vector<int> seen;
+    flux.tryMap(failOn(2))
+        .onErrorResume([fallback](const beast::error_code&) {
+        return fallback;
+    }).subscribe([&seen](int v) { seen.push_back(v); });
+    EXPECT_EQ(seen, (std::vector<int>{10, 7, 8}));
+    EXPECT_TRUE(finished);
+    EXPECT_TRUE(fallbackFinished);
+
+    // A failing fallback fails the flux it stands in for.
+    auto flaky = std::make_shared<Flux<int>>(new FlakySource(1));
+    auto other = Flux<int>::range(std::vector<int>{1, 2});
+    beast::error_code failed;
+    other.onError([&failed](const beast::error_code& ec) { failed = ec; });
+    other.tryMap(failOn(1))
+        .onErrorResume([flaky](const beast::error_code&) { return flaky; })
+        .subscribe([](int) {});
+    EXPECT_EQ(failed, net::error::connection_reset);
+}
+TEST(flux, retry_when_pulls_a_failed_source_again)
+{
+    net::io_context ioc;
+    Flux<int> flaky{new FlakySource(2)};
+    std::vector<std::size_t> attempts;
+    std::vector<int> seen;
+    flaky
+        .retryWhen(ioc.get_executor(),
+                   [&attempts](const beast::error_code&, std::size_t n)
+                       -> std::optional<TimerWheel::Duration> {
+        attempts.push_back(n);
+        return std::chrono::milliseconds(1);
+    }).subscribe([&seen](int v) { seen.push_back(v); });
+    ioc.run();
+    EXPECT_EQ(seen, (std::vector<int>{0, 1, 2}));
+    EXPECT_EQ(attempts, (std::vector<std::size_t>{1, 2}));
+
+    Flux<int> broken{new FlakySource(5)};
+    beast::error_code failed;
+    broken.onError([&failed](const beast::error_code& ec) { failed = ec; });
+    broken
+        .retryWhen(ioc.get_executor(),
+                   [](const beast::error_code&, std::size_t n)
+                       -> std::optional<TimerWheel::Duration> {
+        if (n > 2)
+        {
+            return std::nullopt;
+        }
+        return TimerWheel::Duration::zero();
+    }).subscribe([&seen](int v) { seen.push_back(v); });
+    EXPECT_EQ(failed, net::error::connection_reset);
+    EXPECT_EQ(seen.size(), 3);
+}
+TEST(flux, group_by_routes_values_per_key)
+{
+    std::vector<int> values(12);
+    std::iota(values.begin(), values.end(), 0);
+    auto flux = Flux<int>::range(std::move(values));
+    std::map<int, std::vector<int>> groups;
+    int finished = 0;
+    flux.groupBy([](const int& v) { return v % 3; })
+        .subscribe([&groups, &finished](auto group) {
+        auto& values = groups[group->key()];
+        group->onFinish([&finished]() { ++finished; })
+            .subscribe([&values](int v) { values.push_back(v); });
+    });
+    EXPECT_EQ(groups[0], (std::vector<int>{0, 3, 6, 9}));
+    EXPECT_EQ(groups[1], (std::vector<int>{1, 4, 7, 10}));
+    EXPECT_EQ(groups[2], (std::vector<int>{2, 5, 8, 11}));
+    EXPECT_EQ(finished, 3);
+}
+TEST(flux, group_by_evicts_least_recently_used_groups)
+{
+    auto flux = Flux<std::string>::range(
+        std::vector<std::string>{"a1", "b1", "a2", "c1", "b2"});
+    std::vector<std::string> opened;
+    std::vector<std::string> closed;
+    flux.groupBy([](const std::string& v) { return v.front(); },
+                 GroupByOptions{.maxGroups = 2})
+        .subscribe([&opened, &closed](auto group) {
+        opened.push_back(group->key() + std::string(":"));
+        group->onFinish([&closed, key = group->key()]() {
+            closed.emplace_back(1, key);
+        }).subscribe([&opened, index = opened.size() - 1](std::string v) {
+            opened[index] += v;
+        });
+    });
+    // c evicts b, the least recently used; b then comes back as a new
+    // group and evicts a.
+    EXPECT_EQ(opened, (std::vector<std::string>{"a:a1a2", "b:b1", "c:c1",
+                                                "b:b2"}));
+    EXPECT_EQ(closed, (std::vector<std::string>{"b", "a", "b", "c"}));
+
+    // A full table whose oldest group still has values queued fails.
+    auto busy = Flux<int>::range(std::vector<int>{1, 1, 2});
+    beast::error_code failed;
+    busy.onError([&failed](const beast::error_code& ec) { failed = ec; });
+    std::vector<std::shared_ptr<GroupedFlux<int, int>>> held;
+    busy.groupBy([](const int& v) { return v; },
+                 GroupByOptions{.maxGroups = 1})
+        .subscribe([&held](auto group) {
+        held.push_back(group);
+        group->subscribe([](int, auto&&) {});
+    });
+    EXPECT_EQ(failed, net::error::no_buffer_space);
+}
+// Hands out one value, then goes quiet without finishing.
+struct OneThenQuiet : Flux<int>::SourceHandler
+{
+    bool sent{false};
+    std::function<void(int)> parked;
+    void next(std::function<void(int)> consumer) override
+    {
+        if (std::exchange(sent, true))
+        {
+            parked = std::move(consumer);
+            return;
+        }
+        consumer(7);
+    }
+    bool hasNext() const override
+    {
+        return true;
+    }
+};
+TEST(flux, group_by_completes_idle_groups_while_the_upstream_is_quiet)
+{
+    net::io_context ioc;
+    Flux<int> flux{new OneThenQuiet};
+    std::vector<int> seen;
+    bool finished = false;
+    auto started = std::chrono::steady_clock::now();
+    flux.groupBy([](const int& v) { return v % 2; },
+                 GroupByOptions{.idleTimeout = std::chrono::milliseconds(20),
+                                .timerExecutor = ioc.get_executor()})
+        .subscribe([&seen, &finished](auto group) {
+        group->onFinish([&finished]() { finished = true; })
+            .subscribe([&seen](int v) { seen.push_back(v); });
+    });
+    EXPECT_EQ(seen, (std::vector<int>{7}));
+    EXPECT_FALSE(finished);
+    ioc.run();
+    EXPECT_TRUE(finished);
+    EXPECT_GE(std::chrono::steady_clock::now() - started,
+              std::chrono::milliseconds(20));
+}
+TEST(flux, group_by_pinned_groups_keep_their_order)
+{
+    net::thread_pool pool(4);
+    GroupByOptions options{.prefetch = 4};
+    for (int i = 0; i < 4; ++i)
+    {
+        options.executors.push_back(net::make_strand(pool));
+    }
+    std::vector<int> values(4000);
+    std::iota(values.begin(), values.end(), 0);
+    auto flux = Flux<int>::range(std::move(values));
+    std::map<int, std::vector<int>> groups;
+    std::atomic<int> finished{0};
+    flux.groupBy([](const int& v) { return v % 8; }, std::move(options))
+        .subscribe([&groups, &finished](auto group) {
+        auto& values = groups[group->key()];
+        group->onFinish([&finished]() { ++finished; })
+            .subscribe([&values](int v) { values.push_back(v); });
+    });
+    pool.join();
+    EXPECT_EQ(finished, 8);
+    for (auto& [key, values] : groups)
+    {
+        ASSERT_EQ(values.size(), 500);
+        for (std::size_t i = 0; i < values.size(); ++i)
+        {
+            EXPECT_EQ(values[i], key + static_cast<int>(i) * 8);
+        }
+    }
+}
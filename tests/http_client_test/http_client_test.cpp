@@ -1,4 +1,5 @@
-#include "http/http_client.hpp"
+#include "client/http/http_client.hpp"
+#include "client/http/http_client_pool.hpp"
 
 #include <gtest/gtest.h>
 using namespace reactor;
@@ -52,3 +53,146 @@ TEST(HttpSessionTest, RunTest)
     // Run the io_context to execute asynchronous operations
     ioContext.run();
 }
+
+using PooledSession = AsyncTcpSession<http::string_body>;
+using Pool = HttpClientPool<PooledSession>;
+
+TEST(HttpClientPoolTest, ReusesIdleSessionsPerOrigin)
+{
+    net::io_context ioContext;
+    auto executor = ioContext.get_executor();
+    auto pool = std::make_shared<Pool>(executor, 2);
+    auto make = [executor]() { return PooledSession::create(executor); };
+    auto a = PoolKey::of(boost::urls::url_view("http://127.0.0.1/a"));
+    auto b = PoolKey::of(boost::urls::url_view("http://127.0.0.1:8081/b"));
+    EXPECT_EQ(a.port, "80");
+
+    auto first = pool->tryAcquire(a, make);
+    auto second = pool->tryAcquire(a, make);
+    ASSERT_TRUE(first && second);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(pool->tryAcquire(a, make), nullptr);
+    // Another origin has its own limit.
+    EXPECT_NE(pool->tryAcquire(b, make), nullptr);
+
+    pool->release(first);
+    EXPECT_EQ(pool->stats(a).idle, 1);
+    EXPECT_EQ(pool->tryAcquire(a, make), first);
+
+    pool->discard(second);
+    EXPECT_EQ(pool->stats(a).open, 1);
+    EXPECT_NE(pool->tryAcquire(a, make), nullptr);
+}
+
+TEST(HttpClientPoolTest, QueuesWaitersInOrderWhenSaturated)
+{
+    net::io_context ioContext;
+    auto executor = ioContext.get_executor();
+    auto pool = std::make_shared<Pool>(executor,
+                                       PoolLimits{.perOrigin = 1,
+                                                  .maxWaiters = 2});
+    auto make = [executor]() { return PooledSession::create(executor); };
+    auto key = PoolKey::of(boost::urls::url_view("http://127.0.0.1:8081/"));
+
+    std::vector<int> order;
+    std::vector<std::shared_ptr<PooledSession>> leases(4);
+    auto waiter = [&](int i) {
+        return [&, i](beast::error_code ec,
+                      std::shared_ptr<PooledSession> session) {
+            order.push_back(ec ? -i : i);
+            leases[i] = std::move(session);
+        };
+    };
+    pool->acquire(key, make, waiter(0));
+    auto cancelled = pool->acquire(key, make, waiter(1));
+    pool->acquire(key, make, waiter(2));
+    pool->acquire(key, make, waiter(3));
+    EXPECT_EQ(order, (std::vector<int>{0, -3}));
+    EXPECT_TRUE(cancelled.pending());
+    EXPECT_EQ(pool->stats(key).waiting, 2);
+
+    cancelled.cancel();
+    pool->release(leases[0]);
+    // Handed over from the executor, not from inside release().
+    EXPECT_EQ(order.size(), 2);
+    ioContext.poll();
+    EXPECT_EQ(order, (std::vector<int>{0, -3, 2}));
+    EXPECT_EQ(leases[2], leases[0]);
+    EXPECT_EQ(pool->stats(key).idle, 0);
+
+    pool->acquire(key, make, waiter(1));
+    pool->discard(leases[2]);
+    ioContext.restart();
+    ioContext.poll();
+    EXPECT_EQ(order, (std::vector<int>{0, -3, 2, 1}));
+    ASSERT_NE(leases[1], nullptr);
+    EXPECT_NE(leases[1], leases[2]);
+    EXPECT_EQ(pool->stats(key).open, 1);
+}
+
+TEST(HttpClientPoolTest, RetiresSpentAndIdleSessions)
+{
+    net::io_context ioContext;
+    auto executor = ioContext.get_executor();
+    auto pool = std::make_shared<Pool>(
+        executor, PoolLimits{.perOrigin = 1,
+                             .maxRequests = 2,
+                             .idleTimeout = std::chrono::milliseconds(5)});
+    auto make = [executor]() { return PooledSession::create(executor); };
+    auto key = PoolKey::of(boost::urls::url_view("http://127.0.0.1:8081/"));
+
+    auto first = pool->tryAcquire(key, make);
+    pool->release(first);
+    EXPECT_EQ(pool->tryAcquire(key, make), first);
+    // Its second exchange used up the budget.
+    pool->release(first);
+    EXPECT_EQ(pool->stats(key).open, 0);
+
+    auto second = pool->tryAcquire(key, make);
+    EXPECT_NE(second, first);
+    pool->release(second);
+    EXPECT_EQ(pool->stats(key).idle, 1);
+    ioContext.run();
+
+    auto stats = pool->stats(key);
+    EXPECT_EQ(stats.open, 0);
+    EXPECT_EQ(stats.retired, 2);
+    EXPECT_EQ(stats.acquired, 3);
+    EXPECT_EQ(stats.reused, 1);
+    EXPECT_DOUBLE_EQ(stats.reuseRatio(), 1.0 / 3);
+}
+
+TEST(HttpClientPoolTest, WarmsConnectionsAheadOfRequests)
+{
+    net::io_context ioContext;
+    auto executor = ioContext.get_executor();
+    tcp::acceptor acceptor(ioContext, {net::ip::make_address("127.0.0.1"), 0});
+    std::vector<tcp::socket> accepted;
+    std::function<void()> accept = [&]() {
+        acceptor.async_accept([&](beast::error_code ec, tcp::socket socket) {
+            if (!ec)
+            {
+                accepted.push_back(std::move(socket));
+                accept();
+            }
+        });
+    };
+    accept();
+
+    auto pool = std::make_shared<Pool>(executor, 4);
+    auto make = [executor]() { return PooledSession::create(executor); };
+    auto key = PoolKey::of("http", "127.0.0.1",
+                           std::to_string(acceptor.local_endpoint().port()));
+    pool->warm(key, make, 2);
+    EXPECT_EQ(pool->stats(key).open, 2);
+    ioContext.run_for(std::chrono::milliseconds(200));
+
+    EXPECT_EQ(accepted.size(), 2);
+    EXPECT_EQ(pool->stats(key).idle, 2);
+    auto session = pool->tryAcquire(key, make);
+    ASSERT_NE(session, nullptr);
+    EXPECT_EQ(pool->stats(key).reused, 1);
+    // A warm session that fails is replaced.
+    pool->discard(session);
+    EXPECT_EQ(pool->stats(key).open, 2);
+}
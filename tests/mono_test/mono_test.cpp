@@ -1,5 +1,5 @@
 
-#include "http/web_client.hpp"
+#include "client/http/web_client.hpp"
 
 #include <filesystem>
 #include <fstream>
@@ -99,3 +99,224 @@ TEST(mono, scope_test_sinkgroup)
           return v >= 2;
       }).subscribe(createSinkGroup<bool>(fun1, fun2));
 }
+TEST(mono, arena_owned_adapters)
+{
+    auto mono = Mono<std::string>::just(std::string("hello"));
+    EXPECT_EQ(mono.arenaStats().adapters, 0);
+
+    auto& last = mono.map([](const auto& v) { return v.length(); })
+                     .filter([](const auto& v) { return v > 2; })
+                     .map([](const auto& v) { return v * 2; });
+    // Stages stay in the arena: `auto stage = mono.map(...)` must not
+    // compile.
+    static_assert(!std::is_copy_constructible_v<std::decay_t<decltype(last)>>);
+    auto stats = mono.arenaStats();
+    EXPECT_EQ(stats.adapters, 3);
+    // All three stages fit in the arena's inline block.
+    EXPECT_EQ(stats.upstreamAllocations, 0);
+
+    std::size_t captured{0};
+    last.subscribe([&captured](auto v) { captured = v; });
+    EXPECT_EQ(captured, 10);
+}
+TEST(mono, when_all_typed_tuple)
+{
+    std::tuple<int, std::string, double> captured;
+    auto m = whenAll(Mono<int>::just(1), Mono<std::string>::justPtr("two"),
+                     Mono<double>::just(3.0));
+    m.subscribe([&captured](const auto& v) { captured = v; });
+    EXPECT_EQ(captured, std::make_tuple(1, std::string("two"), 3.0));
+}
+TEST(mono, when_all_vector_keeps_publisher_order)
+{
+    std::vector<std::shared_ptr<Mono<int>>> monos;
+    for (int i = 0; i < 100; ++i)
+    {
+        monos.push_back(Mono<int>::justPtr(i * i));
+    }
+    std::vector<int> captured;
+    auto m = whenAll(std::move(monos));
+    m.subscribe([&captured](const auto& v) { captured = v; });
+    ASSERT_EQ(captured.size(), 100);
+    EXPECT_EQ(captured[7], 49);
+}
+TEST(mono, when_any_first_value)
+{
+    std::variant<int, std::string> captured;
+    auto m = whenAny(Mono<int>::just(1), Mono<std::string>::just("two"));
+    m.subscribe([&captured](const auto& v) { captured = v; });
+    EXPECT_EQ(captured.index(), 0);
+    EXPECT_EQ(std::get<0>(captured), 1);
+}
+TEST(mono, co_await_mono)
+{
+    net::io_context ioc;
+    auto m = Mono<int>::just(42);
+    std::optional<int> captured;
+    net::co_spawn(
+        ioc,
+        [&]() -> net::awaitable<void> {
+        captured = co_await m.asyncGet(net::use_awaitable);
+    },
+        net::detached);
+    ioc.run();
+    EXPECT_EQ(captured, 42);
+}
+TEST(mono, sink_group_reaches_every_sink)
+{
+    int calls{0};
+    auto fun1 = [&calls](std::size_t v) { calls += v; };
+    auto fun2 = [&calls](std::size_t v) { calls += 10 * v; };
+    auto fun3 = [&calls](std::size_t v) { calls += 100 * v; };
+    auto mono = Mono<std::string>::just(std::string("h"));
+    mono.map([](const auto& v) { return v.length(); })
+        .subscribe(createSinkGroup<std::size_t>(fun1, fun2, fun3));
+    EXPECT_EQ(calls, 111);
+}
+TEST(mono, async_sink_group_waits_for_all_sinks)
+{
+    std::vector<int> captured;
+    auto sink1 = [&captured](const int& v, auto&& done) {
+        captured.push_back(v);
+        done(false);
+    };
+    auto sink2 = [&captured](const int& v, auto&& done) {
+        captured.push_back(v * 10);
+        done(v < 2);
+    };
+    auto flux = Flux<int>::range(std::vector<int>{1, 2, 3});
+    flux.subscribe(AsyncSinkGroup<int, decltype(sink1), decltype(sink2)>(
+        sink1, sink2));
+    std::vector<int> expected = {1, 10, 2, 20};
+    EXPECT_EQ(captured, expected);
+}
+struct CountedPayload
+{
+    static inline int copies{0};
+    std::string data;
+    explicit CountedPayload(std::string d) : data(std::move(d)) {}
+    CountedPayload(const CountedPayload& o) : data(o.data)
+    {
+        ++copies;
+    }
+    CountedPayload(CountedPayload&&) = default;
+    CountedPayload& operator=(const CountedPayload& o)
+    {
+        data = o.data;
+        ++copies;
+        return *this;
+    }
+    CountedPayload& operator=(CountedPayload&&) = default;
+};
+TEST(mono, large_payload_moves_without_copies)
+{
+    CountedPayload::copies = 0;
+    std::string buffer(1 << 20, 'x');
+    const char* origin = buffer.data();
+    const char* seen = nullptr;
+    auto m = Mono<CountedPayload>::just(CountedPayload{std::move(buffer)});
+    m.map([](CountedPayload&& p) {
+         p.data[0] = 'y';
+         return std::move(p);
+     })
+        .filter([](const CountedPayload& p) { return p.data.size() > 0; })
+        .subscribe([&seen](CountedPayload&& p) { seen = p.data.data(); });
+    EXPECT_EQ(CountedPayload::copies, 0);
+    EXPECT_EQ(seen, origin);
+}
+TEST(mono, move_only_value)
+{
+    int seen = 0;
+    auto m = Mono<std::unique_ptr<int>>::just(std::make_unique<int>(7));
+    m.map([](std::unique_ptr<int>&& p) {
+         *p *= 2;
+         return std::move(p);
+     })
+        .subscribe([&seen](std::unique_ptr<int> p) { seen = *p; });
+    EXPECT_EQ(seen, 14);
+}
+// Completes from the io_context, like a login request would.
+struct PostedString : Mono<std::string>::SourceHandler
+{
+    net::io_context& ioc;
+    std::string value;
+    bool more{true};
+    PostedString(net::io_context& c, std::string v) :
+        ioc(c), value(std::move(v))
+    {}
+    void next(std::function<void(std::string)> consumer) override
+    {
+        more = false;
+        net::post(ioc, [consumer, v = value]() { consumer(v); });
+    }
+    bool hasNext() const override
+    {
+        return more;
+    }
+};
+TEST(mono, cache_coalesces_concurrent_fetches)
+{
+    net::io_context ioc;
+    int logins = 0;
+    auto token = Mono<std::string>::cache(
+        [&ioc, &logins]() {
+        ++logins;
+        return Mono<std::string>{new PostedString(ioc, "token")};
+    },
+        std::chrono::minutes(1));
+    std::vector<std::string> seen;
+    std::vector<Mono<std::string>> callers;
+    for (int i = 0; i < 5; ++i)
+    {
+        callers.push_back(token->asMono());
+    }
+    for (auto& caller : callers)
+    {
+        caller.subscribe([&seen](std::string v) { seen.push_back(v); });
+    }
+    EXPECT_TRUE(seen.empty());
+    ioc.run();
+    EXPECT_EQ(seen.size(), 5);
+    auto late = token->asMono();
+    late.subscribe([&seen](std::string v) { seen.push_back(v); });
+    EXPECT_EQ(seen.size(), 6);
+    EXPECT_EQ(logins, 1);
+}
+TEST(mono, cache_forgets_a_mono_dropped_while_waiting)
+{
+    net::io_context ioc;
+    auto token = Mono<std::string>::cache(
+        [&ioc]() { return Mono<std::string>{new PostedString(ioc, "token")}; },
+        std::chrono::minutes(1));
+    auto captured = std::make_shared<int>(0);
+    std::vector<std::string> seen;
+    auto kept = token->asMono();
+    kept.subscribe([&seen](std::string v) { seen.push_back(v); });
+    {
+        auto dropped = token->asMono();
+        dropped.subscribe([captured](std::string) { ++*captured; });
+    }
+    EXPECT_EQ(captured.use_count(), 1);
+    ioc.run();
+    EXPECT_EQ(seen, (std::vector<std::string>{"token"}));
+    EXPECT_EQ(*captured, 0);
+}
+TEST(mono, cache_when_and_refresh_ahead)
+{
+    int fetches = 0;
+    auto counter = Mono<int>::cache(
+        [&fetches]() { return Mono<int>::just(++fetches); },
+        std::chrono::minutes(1), std::chrono::minutes(2));
+    counter->cacheWhen([](int v) { return v > 1; });
+    std::vector<int> seen;
+    auto collect = [&seen, &counter]() {
+        auto m = counter->asMono();
+        m.subscribe([&seen](int v) { seen.push_back(v); });
+    };
+    collect(); // 1 is not kept
+    collect(); // 2 is kept, but already inside the refresh window
+    collect(); // serves 2 and refreshes to 3 behind the scenes
+    collect(); // serves 3, refreshing again
+    EXPECT_EQ(seen, (std::vector<int>{1, 2, 2, 3}));
+    EXPECT_EQ(counter->fetches(), 4);
+}
@@ -0,0 +1,92 @@
+#include "core/sinks.hpp"
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+using namespace reactor;
+TEST(sinks, many_producers_keep_per_producer_order)
+{
+    constexpr int producers = 4;
+    constexpr int perProducer = 10000;
+    net::io_context ioc;
+    auto work = net::make_work_guard(ioc);
+    auto sink = Sinks::many<int>(ioc.get_executor(), 256,
+                                 OverflowStrategy::Spin);
+    auto flux = sink->asFlux();
+    std::vector<int> last(producers, -1);
+    bool ordered{true};
+    int received{0};
+    bool finished{false};
+    flux.onFinish([&finished]() { finished = true; })
+        .subscribe([&](int v) {
+        auto& prev = last[v / perProducer];
+        ordered = ordered && prev < v % perProducer;
+        prev = v % perProducer;
+        ++received;
+    });
+    std::thread consumer([&ioc]() { ioc.run(); });
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&sink, p]() {
+            for (int i = 0; i < perProducer; ++i)
+            {
+                sink->tryEmitNext(p * perProducer + i);
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    sink->tryEmitComplete();
+    work.reset();
+    consumer.join();
+    EXPECT_EQ(received, producers * perProducer);
+    EXPECT_EQ(ordered, true);
+    EXPECT_EQ(finished, true);
+    EXPECT_EQ(sink->stats().dropped, 0);
+}
+TEST(sinks, drop_latest_rejects_when_full)
+{
+    net::io_context ioc;
+    auto sink = Sinks::many<int>(ioc.get_executor(), 4);
+    std::vector<EmitResult> results;
+    for (int i = 0; i < 6; ++i)
+    {
+        results.push_back(sink->tryEmitNext(i));
+    }
+    sink->tryEmitComplete();
+    EXPECT_EQ(results[3], EmitResult::Ok);
+    EXPECT_EQ(results[4], EmitResult::FailOverflow);
+    EXPECT_EQ(sink->tryEmitNext(7), EmitResult::FailTerminated);
+
+    std::vector<int> captured;
+    auto flux = sink->asFlux();
+    flux.subscribe([&captured](int v) { captured.push_back(v); });
+    ioc.run();
+    std::vector<int> expected = {0, 1, 2, 3};
+    EXPECT_EQ(captured, expected);
+    EXPECT_EQ(sink->stats().dropped, 2);
+}
+TEST(sinks, drop_oldest_keeps_newest)
+{
+    net::io_context ioc;
+    auto sink = Sinks::many<int>(ioc.get_executor(), 4,
+                                 OverflowStrategy::DropOldest);
+    for (int i = 0; i < 10; ++i)
+    {
+        EXPECT_EQ(sink->tryEmitNext(i), EmitResult::Ok);
+    }
+    sink->tryEmitComplete();
+    std::vector<int> captured;
+    auto flux = sink->asFlux();
+    flux.subscribe([&captured](int v) { captured.push_back(v); });
+    ioc.run();
+    std::vector<int> expected = {6, 7, 8, 9};
+    EXPECT_EQ(captured, expected);
+}
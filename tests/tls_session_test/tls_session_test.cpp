@@ -0,0 +1,206 @@
+#include "client/http/async_streams.hpp"
+#include "ssl/ssl_utils.hpp"
+#include "ssl/tls_server_sessions.hpp"
+
+#include <boost/asio/io_context.hpp>
+
+#include <string>
+
+#include "gtest/gtest.h"
+using namespace reactor;
+
+// Loopback TLS server that answers one request per connection, configured
+// the way SslStreamMakerImpl configures the HttpsServer context.
+struct LoopbackServer
+{
+    net::io_context& ioc;
+    ssl::context ctx{ensuressl::loadCertificate(ssl::context::tls_server,
+                                                "/tmp/reactor_tls_test")};
+    TlsServerSessions sessions;
+    tcp::acceptor acceptor;
+    std::string port;
+
+    LoopbackServer(net::io_context& io, TlsServerOptions options,
+                   unsigned short portNumber = 0) :
+        ioc(io), sessions(std::move(options)),
+        acceptor(ioc, {net::ip::make_address("127.0.0.1"), portNumber}),
+        port(std::to_string(acceptor.local_endpoint().port()))
+    {
+        sessions.apply(ctx);
+    }
+    void accept()
+    {
+        using Stream = ssl::stream<tcp::socket>;
+        auto stream = std::make_shared<Stream>(ioc, ctx);
+        acceptor.async_accept(stream->next_layer(),
+                              [this, stream](beast::error_code ec) {
+            if (ec)
+            {
+                return;
+            }
+            stream->async_handshake(ssl::stream_base::server,
+                                    [this, stream](beast::error_code ec) {
+                if (ec)
+                {
+                    return;
+                }
+                sessions.handshakeDone(stream->native_handle());
+                auto buffer = std::make_shared<beast::flat_buffer>();
+                auto req = std::make_shared<StringbodyRequest>();
+                http::async_read(*stream, *buffer, *req,
+                                 [stream, buffer, req](beast::error_code ec,
+                                                       std::size_t) {
+                    if (ec)
+                    {
+                        return;
+                    }
+                    auto res = std::make_shared<StringbodyResponse>(
+                        http::status::ok, req->version());
+                    res->keep_alive(false);
+                    res->prepare_payload();
+                    http::async_write(*stream, *res,
+                                      [stream, res](beast::error_code,
+                                                    std::size_t) {
+                        stream->async_shutdown([stream](beast::error_code) {});
+                    });
+                });
+            });
+        });
+    }
+};
+
+// Connects once through AsyncSslStream, so the client offers whatever
+// TlsSessionCache holds for the origin.
+static void request(net::io_context& ioc, ssl::context& ctx,
+                    LoopbackServer& server)
+{
+    server.accept();
+    tcp::resolver resolver(ioc);
+    auto stream = std::make_shared<AsyncSslStream>(ioc.get_executor(), ctx);
+    StringbodyRequest req{http::verb::get, "/", 11};
+    req.keep_alive(false);
+    beast::flat_buffer buffer;
+    StringbodyResponse res;
+    stream->setErrorHandler([&stream](beast::error_code ec, const char* what) {
+        ADD_FAILURE() << what << ": " << ec.message();
+        stream->shutDown();
+    });
+    stream->resolve(resolver, "127.0.0.1", server.port.data(),
+                    [&](beast::error_code) {
+        stream->write(req, [&](beast::error_code, std::size_t) {
+            stream->read(buffer, res, [&](beast::error_code, std::size_t) {
+                stream->shutDown();
+            });
+        });
+    });
+    ioc.run();
+    ioc.restart();
+    EXPECT_EQ(res.result(), http::status::ok);
+}
+
+static ssl::context clientContext(bool tls13)
+{
+    ssl::context ctx(ssl::context::tls_client);
+    ctx.set_verify_mode(ssl::verify_none);
+    if (!tls13)
+    {
+        ctx.set_options(ssl::context::no_tlsv1_3);
+    }
+    return ctx;
+}
+
+TEST(tls, client_resumes_with_server_tickets)
+{
+    for (bool tls13 : {true, false})
+    {
+        net::io_context ioc;
+        auto ctx = clientContext(tls13);
+        LoopbackServer server(ioc, {});
+        auto& cache = TlsSessionCache::instance();
+        cache.clear();
+        for (int i = 0; i < 3; ++i)
+        {
+            request(ioc, ctx, server);
+        }
+        auto client = cache.stats();
+        EXPECT_EQ(client.handshakes, 3);
+        EXPECT_EQ(client.resumed, 2);
+        EXPECT_DOUBLE_EQ(client.hitRate(), 2.0 / 3.0);
+        auto stats = server.sessions.stats();
+        EXPECT_EQ(stats.full, 1);
+        EXPECT_EQ(stats.resumed, 2);
+    }
+}
+
+TEST(tls, rotated_ticket_keys_still_resume)
+{
+    net::io_context ioc;
+    auto ctx = clientContext(true);
+    TlsSessionCache::instance().clear();
+    unsigned short port = 0;
+    {
+        LoopbackServer server(ioc, {});
+        port = static_cast<unsigned short>(std::stoi(server.port));
+        request(ioc, ctx, server);
+        server.sessions.rotate();
+        request(ioc, ctx, server);
+        auto stats = server.sessions.stats();
+        EXPECT_EQ(stats.rotations, 1);
+        EXPECT_EQ(stats.full, 1);
+        EXPECT_EQ(stats.resumed, 1);
+    }
+    // A restarted server has new keys: the ticket is refused, not fatal.
+    LoopbackServer restarted(ioc, {}, port);
+    request(ioc, ctx, restarted);
+    auto stats = restarted.sessions.stats();
+    EXPECT_EQ(stats.full, 1);
+    EXPECT_EQ(stats.ticketsRejected, 1);
+}
+
+TEST(tls, shared_cache_outlives_a_server_context)
+{
+    net::io_context ioc;
+    auto ctx = clientContext(false);
+    TlsServerOptions options{.tickets = false, .sharedCache = true};
+    TlsSessionCache::instance().clear();
+    SharedSessionStore::instance().clear();
+    unsigned short port = 0;
+    {
+        LoopbackServer server(ioc, options);
+        port = static_cast<unsigned short>(std::stoi(server.port));
+        request(ioc, ctx, server);
+        EXPECT_EQ(SharedSessionStore::instance().size(), 1);
+        request(ioc, ctx, server);
+        EXPECT_EQ(server.sessions.stats().resumed, 1);
+    }
+    // Without tickets the session lives only in the store, which a new
+    // context on the same origin picks up.
+    LoopbackServer replacement(ioc, options, port);
+    request(ioc, ctx, replacement);
+    EXPECT_EQ(replacement.sessions.stats().resumed, 1);
+    EXPECT_EQ(replacement.sessions.stats().full, 0);
+}
+
+TEST(tls, without_tickets_the_context_cache_resumes)
+{
+    net::io_context ioc;
+    auto ctx = clientContext(false);
+    LoopbackServer server(ioc, {.tickets = false});
+    TlsSessionCache::instance().clear();
+    request(ioc, ctx, server);
+    request(ioc, ctx, server);
+    EXPECT_EQ(server.sessions.stats().full, 1);
+    EXPECT_EQ(server.sessions.stats().resumed, 1);
+}
+
+TEST(tls, no_tickets_and_no_cache_means_full_handshakes)
+{
+    net::io_context ioc;
+    auto ctx = clientContext(true);
+    LoopbackServer server(ioc, {.tickets = false, .sessionCache = false});
+    TlsSessionCache::instance().clear();
+    request(ioc, ctx, server);
+    request(ioc, ctx, server);
+    EXPECT_EQ(server.sessions.stats().full, 2);
+    EXPECT_EQ(TlsSessionCache::instance().stats().resumed, 0);
+}